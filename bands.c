@@ -0,0 +1,124 @@
+#include "bands.h"
+#include "spectrum.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double hz_to_mel(double hz)
+{
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+static double mel_to_hz(double mel)
+{
+    return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+int bands_init(Bands *bands, const BandOptions *opts, int fft_size, int sample_rate)
+{
+    memset(bands, 0, sizeof(*bands));
+
+    double nyquist = sample_rate / 2.0;
+    double lo = opts->min_hz;
+    double hi = opts->max_hz < nyquist ? opts->max_hz : nyquist;
+    if (opts->count <= 0 || lo <= 0.0 || hi <= lo)
+        return -1;
+
+    int count = opts->count;
+    int bins = fft_size / 2 + 1;
+    double df = (double)sample_rate / fft_size;
+
+    bands->edges = malloc(sizeof(float) * (count + 1));
+    bands->first = malloc(sizeof(int) * count);
+    bands->offset = malloc(sizeof(int) * (count + 1));
+    if (!bands->edges || !bands->first || !bands->offset)
+    {
+        bands_free(bands);
+        return -1;
+    }
+    bands->count = count;
+
+    for (int b = 0; b <= count; b++)
+    {
+        double t = (double)b / count;
+        if (opts->scale == BAND_SCALE_MEL)
+            bands->edges[b] = mel_to_hz(hz_to_mel(lo) + (hz_to_mel(hi) - hz_to_mel(lo)) * t);
+        else
+            bands->edges[b] = lo * pow(hi / lo, t);
+    }
+
+    // bin k stands for the frequencies within half a bin of k * df
+    int total = 0;
+    for (int b = 0; b < count; b++)
+    {
+        int first = (int)floor(bands->edges[b] / df + 0.5);
+        int last = (int)floor(bands->edges[b + 1] / df + 0.5);
+        if (last > bins - 1)
+            last = bins - 1;
+        bands->first[b] = first;
+        bands->offset[b] = total;
+        total += last - first + 1;
+    }
+    bands->offset[count] = total;
+
+    bands->weights = malloc(sizeof(float) * total);
+    if (!bands->weights)
+    {
+        bands_free(bands);
+        return -1;
+    }
+
+    for (int b = 0; b < count; b++)
+    {
+        double band_lo = bands->edges[b];
+        double band_hi = bands->edges[b + 1];
+        for (int i = bands->offset[b]; i < bands->offset[b + 1]; i++)
+        {
+            int k = bands->first[b] + i - bands->offset[b];
+            double bin_lo = (k - 0.5) * df;
+            double bin_hi = (k + 0.5) * df;
+            double overlap = fmin(band_hi, bin_hi) - fmax(band_lo, bin_lo);
+            bands->weights[i] = overlap > 0.0 ? overlap / df : 0.0f;
+        }
+    }
+
+    return 0;
+}
+
+// bands_power sums the weighted power of the bins of every band, one sparse mat-vec
+void bands_power(const Bands *bands, const float *magnitude, float *power)
+{
+    for (int b = 0; b < bands->count; b++)
+    {
+        const float *m = magnitude + bands->first[b];
+        const float *w = bands->weights + bands->offset[b];
+        int n = bands->offset[b + 1] - bands->offset[b];
+
+        float sum = 0.0f;
+        for (int i = 0; i < n; i++)
+            sum += w[i] * m[i] * m[i];
+        power[b] = sum;
+    }
+}
+
+// bands_apply writes the level of every band in dB, clamped to SPECTRUM_FLOOR_DB
+void bands_apply(const Bands *bands, const float *magnitude, float *db)
+{
+    bands_power(bands, magnitude, db);
+
+    for (int b = 0; b < bands->count; b++)
+    {
+        float value = db[b] > 1e-20f ? 10.0f * log10f(db[b]) : SPECTRUM_FLOOR_DB;
+        db[b] = value < SPECTRUM_FLOOR_DB ? SPECTRUM_FLOOR_DB : value;
+    }
+}
+
+void bands_free(Bands *bands)
+{
+    free(bands->edges);
+    free(bands->first);
+    free(bands->offset);
+    free(bands->weights);
+    memset(bands, 0, sizeof(*bands));
+}
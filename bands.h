@@ -0,0 +1,33 @@
+#pragma once
+
+// BandScale spaces the band edges between the lowest and highest frequency
+typedef enum BandScale
+{
+    BAND_SCALE_LOG = 0, // equal ratios, every band the same fraction of an octave (constant Q)
+    BAND_SCALE_MEL, // equal steps of perceived pitch
+} BandScale;
+
+typedef struct BandOptions
+{
+    int count; // 0 keeps the linear FFT bins
+    BandScale scale;
+    float min_hz;
+    float max_hz; // capped at the Nyquist frequency
+} BandOptions;
+
+// Bands maps FFT magnitudes to band levels through a sparse weight matrix built once.
+// Every band covers a contiguous run of bins; a bin straddling a band edge is shared
+// in proportion to its overlap, so each bin's power is counted exactly once.
+typedef struct Bands
+{
+    int count;
+    float *edges; // count + 1 frequencies in Hz
+    int *first; // first bin of every band
+    int *offset; // first weight of every band, offset[count] is the number of weights
+    float *weights;
+} Bands;
+
+int bands_init(Bands *bands, const BandOptions *opts, int fft_size, int sample_rate);
+void bands_power(const Bands *bands, const float *magnitude, float *power);
+void bands_apply(const Bands *bands, const float *magnitude, float *db);
+void bands_free(Bands *bands);
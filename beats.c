@@ -0,0 +1,354 @@
+#include "beats.h"
+#include "timing.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// hops around an onset candidate it must be the maximum of, and the hops
+// averaged for the adaptive threshold
+#define ONSET_PRE_MAX 3
+#define ONSET_POST_MAX 3
+#define ONSET_PRE_AVG 10
+#define ONSET_POST_AVG 7
+#define ONSET_MIN_DISTANCE 3 // about 35 ms at 44.1 kHz
+#define ONSET_RATIO 1.5f // how far above the local average a peak has to be
+#define ONSET_DELTA 0.01f // and by how much at least, so noise in near silence doesn't count
+#define ONSET_COMPRESSION 100.0f // log(1 + c * magnitude) evens out loud and quiet partials
+
+// beats snap to the strongest envelope within this fraction of a period of the prediction
+#define BEAT_SNAP 0.1
+
+static int events_push(BeatEvents *list, int frame, float strength, BeatKind kind)
+{
+    if (list->count == list->capacity)
+    {
+        int capacity = list->capacity ? list->capacity + list->capacity / 2 : 256;
+        BeatEvent *events = realloc(list->events, sizeof(BeatEvent) * capacity);
+        if (!events)
+            return -1;
+        list->events = events;
+        list->capacity = capacity;
+    }
+
+    list->events[list->count++] = (BeatEvent){ .frame = frame, .strength = strength, .kind = kind };
+
+    return 0;
+}
+
+int beat_tracker_init(BeatTracker *bt, int sample_rate)
+{
+    memset(bt, 0, sizeof(*bt));
+    bt->sample_rate = sample_rate;
+    bt->last_onset = -ONSET_MIN_DISTANCE;
+    bt->last_beat = -1.0;
+    bt->next_estimate = (int)(TEMPO_WINDOW * sample_rate / ONSET_HOP);
+
+    if (fft_init(&bt->fft, ONSET_FFT_SIZE) != 0)
+        return -1;
+
+    bt->input = malloc(sizeof(float) * ONSET_FFT_SIZE);
+    bt->magnitude = malloc(sizeof(float) * bt->fft.bins);
+    bt->previous = calloc(bt->fft.bins, sizeof(float));
+    if (!bt->input || !bt->magnitude || !bt->previous)
+    {
+        beat_tracker_free(bt);
+        return -1;
+    }
+
+    return 0;
+}
+
+// beat_flux appends the spectral flux of the hop centered on frame: how much the
+// compressed magnitudes rose since the previous hop, averaged over the bins
+static int beat_flux(BeatTracker *bt, const Track *track, int frame)
+{
+    if (bt->flux_count == bt->flux_capacity)
+    {
+        int capacity = bt->flux_capacity ? bt->flux_capacity + bt->flux_capacity / 2 : 4096;
+        float *flux = realloc(bt->flux, sizeof(float) * capacity);
+        if (!flux)
+            return -1;
+        bt->flux = flux;
+        bt->flux_capacity = capacity;
+    }
+
+    int start = frame - ONSET_FFT_SIZE / 2;
+    for (int i = 0; i < ONSET_FFT_SIZE; i++)
+        bt->input[i] = track_mono(track, start + i);
+    fft_magnitude(&bt->fft, bt->input, bt->magnitude);
+
+    float sum = 0.0f;
+    for (int k = 0; k < bt->fft.bins; k++)
+    {
+        float m = logf(1.0f + ONSET_COMPRESSION * bt->magnitude[k]);
+        float rise = m - bt->previous[k];
+        if (rise > 0.0f)
+            sum += rise;
+        bt->previous[k] = m;
+    }
+
+    // the first hop has nothing to rise from
+    float flux = bt->flux_count > 0 ? sum / bt->fft.bins : 0.0f;
+    bt->flux[bt->flux_count++] = flux;
+    if (flux > bt->flux_peak)
+        bt->flux_peak = flux;
+
+    return 0;
+}
+
+// beat_pick_onsets searches the envelope for peaks above the adaptive threshold,
+// as far as the hops after each candidate are known
+static int beat_pick_onsets(BeatTracker *bt)
+{
+    int lookahead = ONSET_POST_MAX > ONSET_POST_AVG ? ONSET_POST_MAX : ONSET_POST_AVG;
+    int end = bt->finished ? bt->flux_count : bt->flux_count - lookahead;
+
+    for (int h = bt->picked; h < end; h++)
+    {
+        float value = bt->flux[h];
+        bool peak = h - bt->last_onset >= ONSET_MIN_DISTANCE;
+        for (int i = h - ONSET_PRE_MAX; i <= h + ONSET_POST_MAX && peak; i++)
+        {
+            if (i >= 0 && i < bt->flux_count && bt->flux[i] > value)
+                peak = false;
+        }
+        if (!peak)
+            continue;
+
+        float sum = 0.0f;
+        int n = 0;
+        for (int i = h - ONSET_PRE_AVG; i <= h + ONSET_POST_AVG; i++)
+        {
+            if (i >= 0 && i < bt->flux_count)
+            {
+                sum += bt->flux[i];
+                n++;
+            }
+        }
+        if (value < sum / n * ONSET_RATIO + ONSET_DELTA)
+            continue;
+
+        if (events_push(&bt->onsets, h * ONSET_HOP, value / bt->flux_peak, BEAT_ONSET) != 0)
+            return -1;
+        bt->last_onset = h;
+    }
+    if (end > bt->picked)
+        bt->picked = end;
+
+    return 0;
+}
+
+// beat_estimate_tempo picks the beat period from the autocorrelation of the last
+// TEMPO_WINDOW seconds of envelope, weighed towards 120 BPM so that a half or double
+// tempo only wins when it is clearly stronger
+static void beat_estimate_tempo(BeatTracker *bt)
+{
+    double hops_per_second = (double)bt->sample_rate / ONSET_HOP;
+    int window = (int)(TEMPO_WINDOW * hops_per_second);
+    if (window > bt->flux_count)
+        window = bt->flux_count;
+    const float *f = bt->flux + bt->flux_count - window;
+
+    int min_lag = (int)floor(60.0 / TEMPO_MAX_BPM * hops_per_second);
+    int max_lag = (int)ceil(60.0 / TEMPO_MIN_BPM * hops_per_second);
+    if (max_lag >= window / 2)
+        return;
+
+    double mean = 0.0;
+    for (int i = 0; i < window; i++)
+        mean += f[i];
+    mean /= window;
+
+    double preferred = 60.0 / 120.0 * hops_per_second;
+    double best = 0.0;
+    int best_lag = 0;
+    double scores[3] = { 0.0, 0.0, 0.0 }; // best lag and its two neighbours
+
+    for (int lag = min_lag - 1; lag <= max_lag + 1; lag++)
+    {
+        double r = 0.0;
+        for (int i = 0; i + lag < window; i++)
+            r += (f[i] - mean) * (f[i + lag] - mean);
+        r /= window - lag;
+
+        double octaves = log2(lag / preferred);
+        double score = r * exp(-0.5 * octaves * octaves);
+        if (lag >= min_lag && lag <= max_lag && score > best)
+        {
+            best = score;
+            best_lag = lag;
+        }
+    }
+    if (best_lag == 0)
+        return;
+
+    // parabolic interpolation around the best lag for a fractional period
+    for (int d = -1; d <= 1; d++)
+    {
+        int lag = best_lag + d;
+        double r = 0.0;
+        for (int i = 0; i + lag < window; i++)
+            r += (f[i] - mean) * (f[i + lag] - mean);
+        double octaves = log2(lag / preferred);
+        scores[d + 1] = r / (window - lag) * exp(-0.5 * octaves * octaves);
+    }
+    double denom = scores[0] - 2.0 * scores[1] + scores[2];
+    double shift = denom < 0.0 ? 0.5 * (scores[0] - scores[2]) / denom : 0.0;
+    if (shift < -0.5 || shift > 0.5)
+        shift = 0.0;
+
+    bt->period = best_lag + shift;
+}
+
+// beat_place extends the beat grid one period at a time, each beat snapped to the
+// strongest envelope close to where it was predicted
+static int beat_place(BeatTracker *bt)
+{
+    if (bt->period <= 0.0)
+        return 0;
+
+    int radius = (int)(bt->period * BEAT_SNAP + 0.5);
+    if (radius < 1)
+        radius = 1;
+    int limit = bt->finished ? bt->flux_count : bt->flux_count - radius - 1;
+
+    if (bt->last_beat < 0.0)
+    {
+        // the phase whose pulse train collects the most onset strength, moved back to the start
+        int period = (int)(bt->period + 0.5);
+        double best = -1.0;
+        for (int phase = 0; phase < period && phase < bt->flux_count; phase++)
+        {
+            double sum = 0.0;
+            for (double h = phase; (int)(h + 0.5) < bt->flux_count; h += bt->period)
+                sum += bt->flux[(int)(h + 0.5)];
+            if (sum > best)
+            {
+                best = sum;
+                bt->last_beat = phase - bt->period;
+            }
+        }
+    }
+
+    while (bt->last_beat + bt->period < limit)
+    {
+        double predicted = bt->last_beat + bt->period;
+        int center = (int)(predicted + 0.5);
+        int h = center;
+        double best = -1.0;
+        for (int i = center - radius; i <= center + radius; i++)
+        {
+            if (i < 0 || i >= bt->flux_count)
+                continue;
+            double d = (i - predicted) / (radius + 1);
+            double score = bt->flux[i] * (1.0 - 0.5 * d * d);
+            if (score > best)
+            {
+                best = score;
+                h = i;
+            }
+        }
+        // in near silence there is nothing to snap to, keep the grid
+        if (bt->flux[h] < ONSET_DELTA)
+            h = center;
+        if (h >= bt->flux_count)
+            break;
+
+        float strength = bt->flux_peak > 0.0f ? bt->flux[h] / bt->flux_peak : 0.0f;
+        if (events_push(&bt->beats, h * ONSET_HOP, strength, BEAT_BEAT) != 0)
+            return -1;
+        bt->last_beat = h;
+    }
+
+    return 0;
+}
+
+// beat_tracker_update analyzes at most max_hops more hops of the decoded track
+// and appends the onsets and beats found. Returns the number of hops analyzed.
+int beat_tracker_update(BeatTracker *bt, const Track *track, int max_hops)
+{
+    if (bt->finished)
+        return 0;
+
+    double start = now_seconds();
+    int done = 0;
+
+    while (done < max_hops)
+    {
+        int frame = bt->flux_count * ONSET_HOP;
+        if (track->complete && frame >= track->size)
+        {
+            bt->finished = true;
+            break;
+        }
+        if (!track->complete && frame + ONSET_FFT_SIZE / 2 > track->size)
+            break;
+        if (beat_flux(bt, track, frame) != 0)
+            return -1;
+        done++;
+
+        if (bt->flux_count >= bt->next_estimate)
+        {
+            beat_estimate_tempo(bt);
+            bt->next_estimate = bt->flux_count + bt->sample_rate / ONSET_HOP;
+        }
+    }
+
+    // a track shorter than the tempo window gets one estimate from all of it
+    if (bt->finished && bt->period <= 0.0)
+        beat_estimate_tempo(bt);
+
+    if (beat_pick_onsets(bt) != 0 || beat_place(bt) != 0)
+        return -1;
+
+    bt->seconds += now_seconds() - start;
+
+    return done;
+}
+
+double beat_tracker_bpm(const BeatTracker *bt)
+{
+    return bt->period > 0.0 ? 60.0 * bt->sample_rate / (bt->period * ONSET_HOP) : 0.0;
+}
+
+void beat_tracker_free(BeatTracker *bt)
+{
+    fft_free(&bt->fft);
+    free(bt->input);
+    free(bt->magnitude);
+    free(bt->previous);
+    free(bt->flux);
+    free(bt->onsets.events);
+    free(bt->beats.events);
+    memset(bt, 0, sizeof(*bt));
+}
+
+// beat_cursor_advance moves the cursor to frame and returns how many events were passed,
+// they end just before cursor->next. Moving back, after a restart, fires nothing.
+int beat_cursor_advance(BeatCursor *cursor, const BeatEvents *events, int frame)
+{
+    if (frame < cursor->frame)
+    {
+        // first event after frame
+        int lo = 0, hi = events->count;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (events->events[mid].frame <= frame)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        cursor->next = lo;
+        cursor->frame = frame;
+        return 0;
+    }
+
+    int first = cursor->next;
+    while (cursor->next < events->count && events->events[cursor->next].frame <= frame)
+        cursor->next++;
+    cursor->frame = frame;
+
+    return cursor->next - first;
+}
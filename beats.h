@@ -0,0 +1,72 @@
+#pragma once
+
+#include "fft.h"
+#include "track.h"
+
+#include <stdbool.h>
+
+#define ONSET_FFT_SIZE 1024
+#define ONSET_HOP 512 // frames between onset envelope values
+#define TEMPO_MIN_BPM 60.0
+#define TEMPO_MAX_BPM 200.0
+#define TEMPO_WINDOW 8.0 // seconds of envelope the tempo is estimated from
+
+typedef enum BeatKind
+{
+    BEAT_ONSET = 0, // any note or drum hit
+    BEAT_BEAT, // a pulse of the tracked tempo
+} BeatKind;
+
+typedef struct BeatEvent
+{
+    int frame;
+    float strength; // onset envelope at the event relative to its peak so far, 0..1
+    BeatKind kind;
+} BeatEvent;
+
+// BeatEvents is a growing list of events sorted by frame
+typedef struct BeatEvents
+{
+    BeatEvent *events;
+    int count;
+    int capacity;
+} BeatEvents;
+
+// BeatCursor walks a BeatEvents list along with playback
+typedef struct BeatCursor
+{
+    int next; // first event not fired yet
+    int frame; // frame of the last advance
+} BeatCursor;
+
+// BeatTracker finds onsets with spectral flux and an adaptive threshold, and beats
+// with a tempo estimated from the autocorrelation of the flux. It works incrementally
+// on the decoded part of the track, which stays ahead of playback.
+typedef struct BeatTracker
+{
+    Fft fft;
+    float *input;
+    float *magnitude;
+    float *previous; // compressed magnitudes of the previous hop
+    float *flux; // onset envelope, one value per hop
+    int flux_count;
+    int flux_capacity;
+    float flux_peak;
+    int picked; // envelope values already searched for onsets
+    int last_onset; // hop of the last onset, for the minimum distance between two
+    BeatEvents onsets;
+    BeatEvents beats;
+    double period; // beat period in hops, 0 until estimated
+    int next_estimate; // envelope length at which the tempo is estimated again
+    double last_beat; // hop of the last beat, negative before the first
+    int sample_rate;
+    bool finished; // the whole track was analyzed
+    double seconds; // time spent analyzing
+} BeatTracker;
+
+int beat_tracker_init(BeatTracker *bt, int sample_rate);
+int beat_tracker_update(BeatTracker *bt, const Track *track, int max_hops);
+double beat_tracker_bpm(const BeatTracker *bt);
+void beat_tracker_free(BeatTracker *bt);
+
+int beat_cursor_advance(BeatCursor *cursor, const BeatEvents *events, int frame);
@@ -0,0 +1,1209 @@
+#include "bench.h"
+#include "bands.h"
+#include "beats.h"
+#include "canvas.h"
+#include "decode.h"
+#include "fft.h"
+#include "pacing.h"
+#include "particles.h"
+#include "peaks.h"
+#include "playback.h"
+#include "profile.h"
+#include "scene.h"
+#include "segment.h"
+#include "spectrogram.h"
+#include "spectrum.h"
+#include "tap.h"
+#include "timing.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int count_sink(void *user, const void *samples, int frames)
+{
+    (void)samples;
+    *(long *)user += frames;
+    return 0;
+}
+
+static const char *thread_type_name(int thread_type)
+{
+    if (thread_type == FF_THREAD_FRAME)
+        return "frame";
+    if (thread_type == FF_THREAD_SLICE)
+        return "slice";
+    return "none";
+}
+
+// bench_decode decodes every file with 1, 2, 4 and one thread per core
+// and prints the decode speed as a multiple of real time.
+int bench_decode(int count, char **paths)
+{
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int threads[] = { 1, 2, 4, cores };
+
+    printf("%-32s %-8s %8s %8s %10s %10s\n", "file", "codec", "threads", "type", "seconds", "realtime");
+
+    for (int f = 0; f < count; f++)
+    {
+        for (int t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])); t++)
+        {
+            DecodeOptions opts = { .sample_rate = 0, .channels = 0, .format = SAMPLE_FORMAT_F32, .threads = threads[t] };
+            DecodeSource src;
+            if (decode_open(&src, paths[f], &opts) != 0)
+                return -1;
+
+            long frames = 0;
+            double start = now_seconds();
+            int ret = decode_run(&src, count_sink, &frames);
+            double elapsed = now_seconds() - start;
+
+            double audio = (double)frames / src.sample_rate;
+            printf("%-32.32s %-8s %8d %8s %10.3f %9.1fx\n", paths[f], src.codec_ctx->codec->name,
+                src.thread_count, thread_type_name(src.thread_type), elapsed, elapsed > 0 ? audio / elapsed : 0.0);
+
+            decode_close(&src);
+            if (ret != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+// bench_segments decodes every file sequentially and then in 2, 4, ... segments up to
+// one per core, printing the speedup and whether the output is bit identical.
+int bench_segments(int count, char **paths)
+{
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    DecodeOptions opts = { .sample_rate = 0, .channels = 0, .format = SAMPLE_FORMAT_F32, .threads = 1 };
+
+    printf("%-32s %8s %10s %8s %10s\n", "file", "segments", "seconds", "speedup", "identical");
+
+    for (int f = 0; f < count; f++)
+    {
+        Track reference;
+        double start = now_seconds();
+        if (decode_file_segmented(paths[f], &opts, 1, &reference) != 0)
+            return -1;
+        double sequential = now_seconds() - start;
+        printf("%-32.32s %8d %10.3f %7.2fx %10s\n", paths[f], 1, sequential, 1.0, "-");
+
+        for (int segments = 2; segments <= (cores > 2 ? cores : 2); segments *= 2)
+        {
+            Track track;
+            start = now_seconds();
+            if (decode_file_segmented(paths[f], &opts, segments, &track) != 0)
+            {
+                track_free(&reference);
+                return -1;
+            }
+            double elapsed = now_seconds() - start;
+
+            bool identical = track.size == reference.size &&
+                memcmp(track.data, reference.data, (size_t)track.size * track.frame_size) == 0;
+            printf("%-32.32s %8d %10.3f %7.2fx %10s\n", paths[f], segments, elapsed,
+                elapsed > 0 ? sequential / elapsed : 0.0, identical ? "yes" : "NO");
+            track_free(&track);
+
+            if (!identical)
+            {
+                track_free(&reference);
+                return -1;
+            }
+        }
+
+        track_free(&reference);
+    }
+
+    return 0;
+}
+
+// write_test_wav writes seconds of a mono 16 bit tone at rate to a new temporary file,
+// whose path is left in path
+static int write_test_wav(char *path, int rate, int seconds)
+{
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    FILE *file = fdopen(fd, "wb");
+    if (!file)
+    {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    uint32_t data_bytes = (uint32_t)rate * seconds * 2;
+    uint32_t riff_bytes = 36 + data_bytes;
+    uint32_t fmt_bytes = 16;
+    uint16_t pcm = 1, channels = 1, block = 2, bits = 16;
+    uint32_t sample_rate = (uint32_t)rate, byte_rate = (uint32_t)rate * 2;
+
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riff_bytes, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmt_bytes, 4, 1, file);
+    fwrite(&pcm, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sample_rate, 4, 1, file);
+    fwrite(&byte_rate, 4, 1, file);
+    fwrite(&block, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&data_bytes, 4, 1, file);
+
+    short block_samples[4096];
+    for (int written = 0; written < rate * seconds; written += 4096)
+    {
+        int n = rate * seconds - written < 4096 ? rate * seconds - written : 4096;
+        for (int i = 0; i < n; i++)
+            block_samples[i] = (short)(12000.0f * sinf((float)((written + i) % rate) * 0.05f));
+        fwrite(block_samples, 2, n, file);
+    }
+
+    if (fclose(file) != 0)
+    {
+        unlink(path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// bench_allocations decodes a short and a long synthetic file into a track like the
+// player does, once at the file's rate and once resampled, and fails if the scratch or
+// track allocations of the long file outnumber those of the short one
+int bench_allocations(void)
+{
+    const int rate = 44100;
+    const int seconds[] = { 10, 600 };
+    const int rates[] = { 0, 48000 };
+    int ret = 0;
+
+    printf("%8s %10s %12s %10s %8s\n", "seconds", "out rate", "frames", "scratch", "track");
+
+    for (int r = 0; r < (int)(sizeof(rates) / sizeof(rates[0])); r++)
+    {
+        int scratch[2];
+        int track_allocations[2];
+
+        for (int s = 0; s < 2; s++)
+        {
+            char path[] = "/tmp/musicviz-alloc-XXXXXX";
+            if (write_test_wav(path, rate, seconds[s]) != 0)
+            {
+                fprintf(stderr, "Could not write a test file\n");
+                return -1;
+            }
+
+            DecodeOptions opts = { .sample_rate = rates[r], .channels = 0, .format = SAMPLE_FORMAT_F32, .threads = 1 };
+            DecodeSource src;
+            if (decode_open(&src, path, &opts) != 0)
+            {
+                unlink(path);
+                return -1;
+            }
+
+            Track track;
+            track_init(&track, src.sample_rate, src.channels, opts.format);
+            track_reserve(&track, decode_expected_frames(&src));
+            int err = decode_run(&src, track_sink, &track);
+
+            scratch[s] = src.allocations;
+            track_allocations[s] = track.allocations;
+            printf("%8d %10d %12d %10d %8d\n", seconds[s], src.sample_rate, track.size, scratch[s], track_allocations[s]);
+
+            decode_close(&src);
+            track_free(&track);
+            unlink(path);
+            if (err != 0)
+                return -1;
+        }
+
+        if (scratch[1] > scratch[0] || track_allocations[1] > track_allocations[0])
+        {
+            fprintf(stderr, "Decoding %d s took more allocations than %d s\n", seconds[1], seconds[0]);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+// bench_peaks builds the peak pyramid of synthetic tracks of growing length and times
+// drawing a whole track overview, which should cost the same whatever the length. It also
+// times the overview of a complete track whose pyramid only covers what the first render
+// frame builds, as on a cache hit, and fails if that grows with the length.
+int bench_peaks(void)
+{
+    const int rate = 44100;
+    const int width = 800;
+    const int minutes[] = { 1, 10, 60, 120 };
+    PeakColumn columns[800];
+
+    printf("%8s %12s %12s %14s %14s\n", "minutes", "build s", "Mframes/s", "overview us", "partial us");
+
+    int ret = 0;
+    double first_partial = 0.0;
+
+    for (int m = 0; m < (int)(sizeof(minutes) / sizeof(minutes[0])); m++)
+    {
+        int frames = minutes[m] * 60 * rate;
+        Track track;
+        track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+        if (track_reserve(&track, frames) != 0)
+            return -1;
+        float *data = (float *)track.data;
+        for (int i = 0; i < frames; i++)
+            data[i] = sinf(i * 0.05f) * (float)(i % rate) / rate;
+        track.size = frames;
+        track.complete = true;
+
+        const int queries = 1000;
+
+        // the main loop builds 1 << 19 frames of the pyramid per render frame
+        Peaks partial;
+        peaks_init(&partial, frames);
+        peaks_update(&partial, &track, 1 << 19);
+        double start = now_seconds();
+        for (int q = 0; q < queries; q++)
+            peaks_query(&partial, &track, 0.0, (double)frames / width, width, columns);
+        double partial_query = (now_seconds() - start) / queries;
+        peaks_free(&partial);
+
+        Peaks peaks;
+        peaks_init(&peaks, frames);
+        start = now_seconds();
+        peaks_update(&peaks, &track, frames);
+        double build = now_seconds() - start;
+
+        start = now_seconds();
+        for (int q = 0; q < queries; q++)
+            peaks_query(&peaks, &track, 0.0, (double)frames / width, width, columns);
+        double query = (now_seconds() - start) / queries;
+
+        printf("%8d %12.3f %12.1f %14.1f %14.1f\n", minutes[m], build, frames / build / 1e6, query * 1e6,
+            partial_query * 1e6);
+
+        // bounded by PEAKS_RAW_SAMPLES per column, allow for timing noise
+        if (m == 0)
+            first_partial = partial_query;
+        else if (partial_query > 4.0 * first_partial + 50e-6)
+        {
+            fprintf(stderr, "Overview of a partly summarized %d minute track takes %.0f us\n", minutes[m], partial_query * 1e6);
+            ret = -1;
+        }
+
+        peaks_free(&peaks);
+        track_free(&track);
+    }
+
+    return ret;
+}
+
+// the frame raster_golden compares against, delete it to write a new one
+#define RASTER_GOLDEN_PATH "./resources/golden/raster_800x450.png"
+// largest difference allowed in any channel of any pixel
+#define RASTER_GOLDEN_TOLERANCE 2
+
+// raster_golden draws one frame of fixed inputs at 800x450 and compares it channel
+// by channel with the reference image, writing the reference when there is none
+static int raster_golden(void)
+{
+    const int width = 800;
+    const int height = 450;
+    const int rate = 44100;
+    const int frames = 10 * rate;
+
+    Track track;
+    track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+    if (track_reserve(&track, frames) != 0)
+        return -1;
+    // a triangle wave under a rising envelope, no libm so every machine draws the same frame
+    float *data = (float *)track.data;
+    for (int i = 0; i < frames; i++)
+    {
+        float phase = (float)(i % 200) / 100.0f;
+        float triangle = phase < 1.0f ? phase * 2.0f - 1.0f : 3.0f - phase * 2.0f;
+        data[i] = triangle * (float)(i % rate) / rate;
+    }
+    track.size = frames;
+    track.complete = true;
+
+    Peaks peaks;
+    peaks_init(&peaks, frames);
+    peaks_update(&peaks, &track, frames);
+
+    float spectrum[512];
+    for (int k = 0; k < 512; k++)
+        spectrum[k] = SPECTRUM_FLOOR_DB * k / 512;
+
+    Canvas canvas;
+    Scene scene;
+    DrawBackend draw;
+    if (canvas_init(&canvas, width, height) != 0)
+        return -1;
+    if (scene_init(&scene, "Crystal Castles - Celestica", width, height) != 0)
+    {
+        canvas_free(&canvas);
+        return -1;
+    }
+    canvas_backend(&canvas, &draw);
+
+    SceneState state = {
+        .track = &track,
+        .peaks = &peaks,
+        .played_frame = 3.5 * rate,
+        .time_length = (double)frames / rate,
+        .frames_per_column = 1,
+        .spectrum = spectrum,
+        .spectrum_bins = 512,
+    };
+    scene_draw(&scene, &draw, &state);
+
+    int ret = 0;
+    Image reference = LoadImage(RASTER_GOLDEN_PATH);
+    if (!reference.data)
+    {
+        Image frame = {
+            .data = canvas.pixels,
+            .width = width,
+            .height = height,
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+        };
+        if (ExportImage(frame, RASTER_GOLDEN_PATH))
+            fprintf(stderr, "No reference frame, wrote %s\n", RASTER_GOLDEN_PATH);
+        else
+            fprintf(stderr, "No reference frame and could not write %s\n", RASTER_GOLDEN_PATH);
+        ret = -1;
+    }
+    else
+    {
+        ImageFormat(&reference, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        if (reference.width != width || reference.height != height)
+        {
+            fprintf(stderr, "Reference frame is %dx%d, expected %dx%d\n", reference.width, reference.height, width, height);
+            ret = -1;
+        }
+        else
+        {
+            const unsigned char *want = reference.data;
+            const unsigned char *got = (const unsigned char *)canvas.pixels;
+            long wrong = 0;
+            int worst = 0;
+            for (long p = 0; p < (long)width * height; p++)
+            {
+                bool off = false;
+                for (int c = 0; c < 4; c++)
+                {
+                    int diff = abs(got[p * 4 + c] - want[p * 4 + c]);
+                    if (diff > worst)
+                        worst = diff;
+                    if (diff > RASTER_GOLDEN_TOLERANCE)
+                        off = true;
+                }
+                wrong += off;
+            }
+
+            printf("golden %dx%d: %ld pixels off by more than %d, largest channel difference %d\n", width, height,
+                wrong, RASTER_GOLDEN_TOLERANCE, worst);
+            if (wrong > 0)
+            {
+                fprintf(stderr, "Frame differs from %s\n", RASTER_GOLDEN_PATH);
+                ret = -1;
+            }
+        }
+        UnloadImage(reference);
+    }
+
+    scene_free(&scene);
+    canvas_free(&canvas);
+    peaks_free(&peaks);
+    track_free(&track);
+
+    return ret;
+}
+
+// bench_raster checks a frame of fixed inputs against the reference image, then draws
+// the visualizer frame with the CPU rasterizer at growing resolutions and prints the
+// frames per second.
+int bench_raster(void)
+{
+    if (raster_golden() != 0)
+        return -1;
+
+    const int rate = 44100;
+    const int frames = 60 * rate;
+    const int sizes[][2] = { { 800, 450 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    Track track;
+    track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+    if (track_reserve(&track, frames) != 0)
+        return -1;
+    float *data = (float *)track.data;
+    for (int i = 0; i < frames; i++)
+        data[i] = sinf(i * 0.05f) * (float)(i % rate) / rate;
+    track.size = frames;
+    track.complete = true;
+
+    Peaks peaks;
+    peaks_init(&peaks, frames);
+    peaks_update(&peaks, &track, frames);
+
+    printf("%12s %10s %10s %12s\n", "size", "frames", "fps", "ms/frame");
+
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        Canvas canvas;
+        Scene scene;
+        DrawBackend draw;
+        if (canvas_init(&canvas, width, height) != 0)
+            return -1;
+        if (scene_init(&scene, "Crystal Castles - Celestica", width, height) != 0)
+        {
+            canvas_free(&canvas);
+            return -1;
+        }
+        canvas_backend(&canvas, &draw);
+
+        // draw for about two seconds, walking the cursor through the track
+        int count = 0;
+        double start = now_seconds();
+        double elapsed = 0.0;
+        while (elapsed < 2.0)
+        {
+            SceneState state = {
+                .track = &track,
+                .peaks = &peaks,
+                .played_frame = (double)((long)count * rate / 60 % frames),
+                .time_length = (double)frames / rate,
+                .frames_per_column = 1,
+            };
+            scene_draw(&scene, &draw, &state);
+            count++;
+            elapsed = now_seconds() - start;
+        }
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", width, height);
+        printf("%12s %10d %10.1f %12.3f\n", size, count, count / elapsed, elapsed * 1000.0 / count);
+
+        scene_free(&scene);
+        canvas_free(&canvas);
+    }
+
+    peaks_free(&peaks);
+    track_free(&track);
+
+    return 0;
+}
+
+// bench_fft times the real FFT at every supported size and checks it against
+// a naive DFT of the same windowed input. It prints which butterflies the build runs.
+int bench_fft(void)
+{
+    printf("butterflies: %s\n", fft_simd());
+    printf("%8s %12s %14s %14s\n", "size", "us", "frames/240Hz", "max rel err");
+
+    for (int size = FFT_MIN_SIZE; size <= FFT_MAX_SIZE; size *= 2)
+    {
+        Fft fft;
+        if (fft_init(&fft, size) != 0)
+            return -1;
+
+        float *input = malloc(sizeof(float) * size);
+        float *re = malloc(sizeof(float) * fft.bins);
+        float *im = malloc(sizeof(float) * fft.bins);
+        if (!input || !re || !im)
+            return -1;
+
+        srand(size);
+        for (int i = 0; i < size; i++)
+            input[i] = sinf(i * 0.3f) + 0.5f * cosf(i * 1.7f) + (float)rand() / RAND_MAX - 0.5f;
+
+        fft_forward(&fft, input, re, im);
+
+        // every bin of the smaller sizes, a spread of bins of the larger ones
+        double error = 0.0, peak = 0.0;
+        int stride = size > 4096 ? 7 : 1;
+        for (int k = 0; k < fft.bins; k += stride)
+        {
+            double sr = 0.0, si = 0.0;
+            for (int t = 0; t < size; t++)
+            {
+                double x = (double)input[t] * fft.window[t];
+                sr += x * cos(2.0 * M_PI * k * t / size);
+                si -= x * sin(2.0 * M_PI * k * t / size);
+            }
+            double e = hypot(sr - re[k], si - im[k]);
+            if (e > error)
+                error = e;
+            if (hypot(sr, si) > peak)
+                peak = hypot(sr, si);
+        }
+
+        int count = 0;
+        double start = now_seconds();
+        double elapsed = 0.0;
+        while (elapsed < 0.5)
+        {
+            fft_forward(&fft, input, re, im);
+            count++;
+            elapsed = now_seconds() - start;
+        }
+        double us = elapsed * 1e6 / count;
+
+        printf("%8d %12.2f %14.0f %14.2e\n", size, us, (1e6 / 240.0) / us, error / peak);
+
+        free(input);
+        free(re);
+        free(im);
+        fft_free(&fft);
+
+        if (error / peak > 1e-4)
+        {
+            fprintf(stderr, "FFT of size %d does not match the DFT\n", size);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// bench_spectrogram builds the spectrogram of a ten minute synthetic track at a few
+// FFT sizes on one thread and on every core.
+int bench_spectrogram(void)
+{
+    const int rate = 44100;
+    const int frames = 10 * 60 * rate;
+    const int sizes[] = { 1024, 4096, 8192 };
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int threads[] = { 1, cores };
+
+    Track track;
+    track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+    if (track_reserve(&track, frames) != 0)
+        return -1;
+    float *data = (float *)track.data;
+    for (int i = 0; i < frames; i++)
+        data[i] = sinf(i * 0.05f) * (float)(i % rate) / rate;
+    track.size = frames;
+    track.complete = true;
+
+    printf("%8s %8s %8s %10s %14s %10s\n", "fft", "hop", "threads", "build s", "s per minute", "MB");
+
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        for (int t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])); t++)
+        {
+            Spectrogram sg;
+            if (spectrogram_build(&sg, &track, sizes[s], sizes[s] / 4, NULL, threads[t]) != 0)
+                return -1;
+
+            printf("%8d %8d %8d %10.3f %14.3f %10.1f\n", sg.fft_size, sg.hop, threads[t],
+                sg.build_seconds, sg.build_seconds / 10.0, spectrogram_bytes(&sg) / (1024.0 * 1024.0));
+            spectrogram_free(&sg);
+        }
+    }
+
+    track_free(&track);
+
+    return 0;
+}
+
+// bench_bands times the band mapping of an 8192 point spectrum into 64, 256 and 1024
+// bands and checks that a flat spectrum puts exactly its width in bins into every band.
+int bench_bands(void)
+{
+    const int rate = 44100;
+    const int size = 8192;
+    const int counts[] = { 64, 256, 1024 };
+    const BandScale scales[] = { BAND_SCALE_LOG, BAND_SCALE_MEL };
+    const int bins = size / 2 + 1;
+    const double df = (double)rate / size;
+
+    float *flat = malloc(sizeof(float) * bins);
+    float *magnitude = malloc(sizeof(float) * bins);
+    float *power = malloc(sizeof(float) * 1024);
+    if (!flat || !magnitude || !power)
+        return -1;
+    for (int k = 0; k < bins; k++)
+    {
+        flat[k] = 1.0f;
+        magnitude[k] = (float)rand() / RAND_MAX;
+    }
+
+    printf("%8s %6s %10s %12s %14s\n", "bands", "scale", "weights", "us", "max rel err");
+
+    int ret = 0;
+    for (int s = 0; s < (int)(sizeof(scales) / sizeof(scales[0])); s++)
+    {
+        for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+        {
+            BandOptions opts = { .count = counts[c], .scale = scales[s], .min_hz = 20.0f, .max_hz = 20000.0f };
+            Bands bands;
+            if (bands_init(&bands, &opts, size, rate) != 0)
+                return -1;
+
+            bands_power(&bands, flat, power);
+            double error = 0.0;
+            for (int b = 0; b < bands.count; b++)
+            {
+                double width = (bands.edges[b + 1] - bands.edges[b]) / df;
+                double e = fabs(power[b] - width) / width;
+                if (e > error)
+                    error = e;
+            }
+
+            int count = 0;
+            double start = now_seconds();
+            double elapsed = 0.0;
+            while (elapsed < 0.25)
+            {
+                bands_power(&bands, magnitude, power);
+                count++;
+                elapsed = now_seconds() - start;
+            }
+
+            printf("%8d %6s %10d %12.2f %14.2e\n", bands.count, scales[s] == BAND_SCALE_MEL ? "mel" : "log",
+                bands.offset[bands.count], elapsed * 1e6 / count, error);
+            bands_free(&bands);
+
+            if (error > 1e-4)
+            {
+                fprintf(stderr, "%d %s bands do not preserve the spectrum energy\n", counts[c], scales[s] == BAND_SCALE_MEL ? "mel" : "log");
+                ret = -1;
+            }
+        }
+    }
+
+    free(flat);
+    free(magnitude);
+    free(power);
+
+    return ret;
+}
+
+// events_score matches events to the expected frames within tol frames, each expected
+// frame at most once, and returns the F-measure
+static double events_score(const BeatEvents *list, const int *expected, int count, int tol, double *precision, double *recall)
+{
+    int hits = 0;
+    int next = 0;
+    for (int i = 0; i < list->count; i++)
+    {
+        // both lists are sorted, skip expected frames too early to match anymore
+        while (next < count && expected[next] < list->events[i].frame - tol)
+            next++;
+        if (next < count && abs(expected[next] - list->events[i].frame) <= tol)
+        {
+            hits++;
+            next++;
+        }
+    }
+
+    *precision = list->count ? (double)hits / list->count : 0.0;
+    *recall = count ? (double)hits / count : 0.0;
+
+    return *precision + *recall > 0.0 ? 2.0 * *precision * *recall / (*precision + *recall) : 0.0;
+}
+
+// bench_beats runs the onset and beat tracker over one minute click tracks at several
+// tempos, over a quiet tone and noise, and prints precision and recall within 50 ms
+// along with the analysis speed as a multiple of real time
+int bench_beats(void)
+{
+    const int rate = 44100;
+    const int frames = 60 * rate;
+    const double bpms[] = { 90.0, 120.0, 140.0, 174.0 };
+
+    printf("%6s %8s %8s %8s %8s %8s %8s %10s\n", "bpm", "found", "onset P", "onset R", "beat P", "beat R", "beat F", "realtime");
+
+    int ret = 0;
+    for (int b = 0; b < (int)(sizeof(bpms) / sizeof(bpms[0])); b++)
+    {
+        Track track;
+        track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+        if (track_reserve(&track, frames) != 0)
+            return -1;
+        float *data = (float *)track.data;
+
+        srand(b + 1);
+        for (int i = 0; i < frames; i++)
+            data[i] = 0.05f * sinf(i * 0.02f) + 0.02f * ((float)rand() / RAND_MAX - 0.5f);
+
+        // 20 ms noise clicks with a 3 ms decay
+        int expected[512];
+        int count = 0;
+        double period = 60.0 / bpms[b] * rate;
+        for (double f = 0.5 * rate; f < frames - rate / 10 && count < 512; f += period)
+        {
+            int start = (int)f;
+            expected[count++] = start;
+            for (int i = 0; i < rate / 50; i++)
+                data[start + i] += 0.8f * expf(-i / (rate * 0.003f)) * ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+        }
+        track.size = frames;
+        track.complete = true;
+
+        BeatTracker bt;
+        if (beat_tracker_init(&bt, rate) != 0)
+            return -1;
+        double start = now_seconds();
+        while (!bt.finished)
+        {
+            if (beat_tracker_update(&bt, &track, 1 << 20) < 0)
+                return -1;
+        }
+        double elapsed = now_seconds() - start;
+
+        int tol = rate / 20;
+        double onsetP, onsetR, beatP, beatR;
+        events_score(&bt.onsets, expected, count, tol, &onsetP, &onsetR);
+        double beatF = events_score(&bt.beats, expected, count, tol, &beatP, &beatR);
+
+        printf("%6.0f %8.1f %8.2f %8.2f %8.2f %8.2f %8.2f %9.0fx\n", bpms[b], beat_tracker_bpm(&bt),
+            onsetP, onsetR, beatP, beatR, beatF, 60.0 / elapsed);
+
+        if (onsetP < 0.95 || onsetR < 0.95 || beatF < 0.9)
+        {
+            fprintf(stderr, "Beat tracking at %.0f BPM is below the expected precision and recall\n", bpms[b]);
+            ret = -1;
+        }
+
+        beat_tracker_free(&bt);
+        track_free(&track);
+    }
+
+    return ret;
+}
+
+typedef struct TapProducer
+{
+    AudioTap *tap;
+    _Atomic int stop;
+    long pushes;
+} TapProducer;
+
+// tap_producer pushes blocks of random size holding their own positions, like the audio
+// refill would with samples
+static void *tap_producer(void *arg)
+{
+    TapProducer *producer = arg;
+    float block[8192];
+    uint64_t position = 0;
+    unsigned seed = 1;
+
+    while (!atomic_load(&producer->stop))
+    {
+        int count = 1 + rand_r(&seed) % 8192;
+        for (int i = 0; i < count; i++)
+            block[i] = (float)((position + i) & 0xFFFFF);
+        audio_tap_push(producer->tap, block, count);
+        position += count;
+        producer->pushes++;
+    }
+
+    return NULL;
+}
+
+// bench_tap has a thread push to the audio tap as fast as it can for two seconds while
+// windows are read back at random distances behind and ahead of the producer. Every
+// sample handed out has to be the one pushed at that position; windows the producer
+// overwrote must be reported as overruns, never returned.
+int bench_tap(void)
+{
+    const int window = 1024;
+
+    AudioTap *tap = malloc(sizeof(AudioTap));
+    if (!tap)
+        return -1;
+    audio_tap_init(tap);
+
+    TapProducer producer = { .tap = tap, .stop = 0, .pushes = 0 };
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, tap_producer, &producer) != 0)
+    {
+        free(tap);
+        return -1;
+    }
+
+    float out[1024];
+    long reads = 0;
+    long copied = 0;
+    long corrupt = 0;
+    unsigned seed = 2;
+    double start = now_seconds();
+    while (now_seconds() - start < 2.0)
+    {
+        // from a little ahead of the producer to a little past the capacity behind it
+        uint64_t written = audio_tap_written(tap);
+        long behind = (long)(rand_r(&seed) % (AUDIO_TAP_CAPACITY + 2 * window)) - window;
+        if (behind > (long)written)
+            continue;
+        uint64_t position = written - behind;
+
+        int got = audio_tap_read(tap, position, out, window, NULL);
+        reads++;
+        if (got <= 0)
+            continue;
+
+        copied += got;
+        for (int i = 0; i < got; i++)
+        {
+            if (out[i] != (float)((position + i) & 0xFFFFF))
+            {
+                corrupt++;
+                break;
+            }
+        }
+    }
+    atomic_store(&producer.stop, 1);
+    pthread_join(thread, NULL);
+
+    double elapsed = now_seconds() - start;
+    printf("%10s %10s %10s %10s %10s %10s %12s\n", "pushes", "reads", "overruns", "underruns", "corrupt", "Msamples/s", "copied");
+    printf("%10ld %10ld %10ld %10ld %10ld %10.1f %12ld\n", producer.pushes, reads, tap->overruns, tap->underruns,
+        corrupt, audio_tap_written(tap) / elapsed / 1e6, copied);
+
+    free(tap);
+
+    if (corrupt > 0)
+    {
+        fprintf(stderr, "%ld reads returned overwritten samples\n", corrupt);
+        return -1;
+    }
+
+    return 0;
+}
+
+// bench_stalls plays a tone while a simulated render loop stalls for 100 ms (or the given
+// number of milliseconds) every 20 frames, first refilling the device from the loop and
+// then from the audio thread, and prints the underruns of each. Needs an audio device.
+int bench_stalls(int argc, char **argv)
+{
+    const int rate = 44100;
+    const double seconds = 10.0;
+    const int stallMs = argc > 0 ? atoi(argv[0]) : 100;
+    const struct timespec frame = { 0, 16 * 1000000L };
+    const struct timespec stall = { stallMs / 1000, (stallMs % 1000) * 1000000L };
+
+    Track track;
+    track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+    int frames = (int)(seconds + 2.0) * rate;
+    if (track_reserve(&track, frames) != 0)
+        return -1;
+    float *data = (float *)track.data;
+    for (int i = 0; i < frames; i++)
+        data[i] = 0.2f * sinf(2.0f * PI * 440.0f * i / rate);
+    track.size = frames;
+    track.complete = true;
+
+    SetTraceLogLevel(LOG_WARNING);
+    InitAudioDevice();
+    if (!IsAudioDeviceReady())
+    {
+        fprintf(stderr, "No audio device\n");
+        track_free(&track);
+        return -1;
+    }
+
+    printf("%12s %8s %10s\n", "refill", "stalls", "underruns");
+
+    int ret = 0;
+    for (int threaded = 0; threaded <= 1 && ret == 0; threaded++)
+    {
+        Playback pb;
+        if (playback_init(&pb, rate, 1, SAMPLE_FORMAT_F32) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        if (threaded && playback_start(&pb, &track) != 0)
+        {
+            playback_free(&pb);
+            ret = -1;
+            break;
+        }
+
+        int stalls = 0;
+        double start = now_seconds();
+        for (int f = 1; now_seconds() - start < seconds; f++)
+        {
+            if (!threaded)
+                playback_update(&pb, &track);
+            nanosleep(&frame, NULL);
+            if (f % 20 == 0)
+            {
+                nanosleep(&stall, NULL);
+                stalls++;
+            }
+        }
+
+        long underruns = playback_underruns(&pb);
+        printf("%12s %8d %10ld\n", threaded ? "audio thread" : "render loop", stalls, underruns);
+        if (threaded && underruns > 0)
+        {
+            fprintf(stderr, "The audio thread ran dry %ld times\n", underruns);
+            ret = -1;
+        }
+
+        playback_free(&pb);
+    }
+
+    CloseAudioDevice();
+    track_free(&track);
+
+    return ret;
+}
+
+// bench_pacing runs a render loop drawing the visualizer with the CPU rasterizer under
+// each pacing mode, capped at 60 fps, for three seconds of a track zoomed out to 4096
+// frames per column, and prints the frame rate, redraws, frame time jitter and the CPU
+// time of the loop
+int bench_pacing(void)
+{
+    const int rate = 44100;
+    const int frames = 60 * rate;
+    const int zoom = 4096;
+    const PacingMode modes[] = { PACING_FREE, PACING_CAP, PACING_ON_CHANGE };
+
+    Track track;
+    track_init(&track, rate, 1, SAMPLE_FORMAT_F32);
+    if (track_reserve(&track, frames) != 0)
+        return -1;
+    float *data = (float *)track.data;
+    for (int i = 0; i < frames; i++)
+        data[i] = sinf(i * 0.05f) * (float)(i % rate) / rate;
+    track.size = frames;
+    track.complete = true;
+
+    Peaks peaks;
+    peaks_init(&peaks, frames);
+    peaks_update(&peaks, &track, frames);
+
+    Canvas canvas;
+    Scene scene;
+    DrawBackend draw;
+    if (canvas_init(&canvas, 800, 450) != 0)
+        return -1;
+    if (scene_init(&scene, "Crystal Castles - Celestica", 800, 450) != 0)
+    {
+        canvas_free(&canvas);
+        return -1;
+    }
+    canvas_backend(&canvas, &draw);
+
+    printf("%8s %10s %10s %10s %10s %10s %8s\n", "pacing", "frames/s", "redraws/s", "frame ms", "jitter ms", "max ms", "CPU %");
+
+    for (int m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++)
+    {
+        FramePacer pacer;
+        frame_pacer_init(&pacer, modes[m], 60);
+        long drawnColumn = -1;
+        double start = now_seconds();
+        while (now_seconds() - start < 3.0)
+        {
+            frame_pacer_wait(&pacer);
+
+            double played = (now_seconds() - start) * rate;
+            long column = (long)(played / zoom);
+            if (modes[m] == PACING_ON_CHANGE && column == drawnColumn)
+                continue;
+            drawnColumn = column;
+
+            SceneState state = {
+                .track = &track,
+                .peaks = &peaks,
+                .played_frame = played,
+                .time_length = (double)frames / rate,
+                .frames_per_column = zoom,
+            };
+            scene_draw(&scene, &draw, &state);
+            frame_pacer_redrawn(&pacer);
+        }
+
+        FramePacerStats stats;
+        frame_pacer_stats(&pacer, &stats);
+        printf("%8s %10.1f %10.1f %10.3f %10.3f %10.3f %8.1f\n", pacing_mode_name(modes[m]), stats.fps,
+            stats.redraws_per_second, stats.frame_ms, stats.jitter_ms, stats.max_ms, stats.cpu_percent);
+    }
+
+    scene_free(&scene);
+    canvas_free(&canvas);
+    peaks_free(&peaks);
+    track_free(&track);
+
+    return 0;
+}
+
+// bench_profile prints the cost of a stage timer compiled in but disabled, and
+// enabled, next to the bare loop it wraps, then checks the overlay percentiles
+// against events of known length
+int bench_profile(void)
+{
+    const int scopes = 10000000;
+    volatile unsigned work = 0;
+
+    printf("%10s %14s\n", "timers", "ns per scope");
+
+    double start = now_seconds();
+    for (int i = 0; i < scopes; i++)
+        work += i;
+    double bare = now_seconds() - start;
+    printf("%10s %14.2f\n", "none", bare / scopes * 1e9);
+
+    for (int enabled = 0; enabled <= 1; enabled++)
+    {
+        profile_enable(enabled);
+        start = now_seconds();
+        for (int i = 0; i < scopes; i++)
+        {
+            double scope = profile_begin();
+            work += i;
+            profile_end(PROFILE_ANALYSIS, scope);
+        }
+        double elapsed = now_seconds() - start;
+        printf("%10s %14.2f\n", enabled ? "enabled" : "disabled", (elapsed - bare) / scopes * 1e9);
+    }
+
+    // 1000 draws of 1 to 1000 microseconds, p50 is 0.5 ms and p99 0.99 ms
+    double now = now_seconds();
+    for (int i = 1000; i >= 1; i--)
+        profile_record(PROFILE_DRAW, now, now + i * 1e-6);
+    profile_enable(false);
+
+    ProfileStats stats[PROFILE_STAGES];
+    profile_summarize(stats);
+    printf("draw p50 %.3f ms, p99 %.3f ms over %d events\n", stats[PROFILE_DRAW].p50_ms, stats[PROFILE_DRAW].p99_ms,
+        stats[PROFILE_DRAW].count);
+    if (stats[PROFILE_DRAW].count != 1000 || fabs(stats[PROFILE_DRAW].p50_ms - 0.5) > 1e-6 ||
+        fabs(stats[PROFILE_DRAW].p99_ms - 0.99) > 1e-6)
+    {
+        fprintf(stderr, "Profile percentiles are off\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// bench_particles times Emitter_Update over emitters of 10k, 100k and 1M live particles
+// against the scalar reference, and fails if the vectorized integrator drifts more than
+// a thousandth of a pixel from it over a second of updates. Then it sweeps how full a
+// 200k particle emitter is, times spawning bursts of particles and writing their quads
+// for drawing, checks and times the color ramps, and times a 1M particle system updated
+// on 1 to 16 threads, failing if any update differs from the one on a single thread.
+int bench_particles(void)
+{
+    const size_t counts[] = { 10000, 100000, 1000000 };
+
+    printf("%10s %12s %14s %14s %12s\n", "particles", "ms/update", "Mparticles/s", "scalar Mp/s", "max error px");
+
+    int ret = 0;
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+    {
+        // about a second of updates for each size
+        ParticleBench result;
+        if (particles_bench(counts[c], (int)(20000000 / counts[c]), &result) != 0)
+            return -1;
+
+        printf("%10zu %12.3f %14.1f %14.1f %12.2e\n", counts[c], result.update_seconds * 1000.0,
+            counts[c] / result.update_seconds / 1e6, counts[c] / result.reference_seconds / 1e6, result.max_error);
+
+        if (!(result.max_error <= 1e-3))
+        {
+            fprintf(stderr, "Vectorized particles drifted %g px from the scalar reference\n", result.max_error);
+            ret = -1;
+        }
+    }
+
+    const size_t capacity = 200000;
+    const double occupancies[] = { 0.0, 0.001, 0.01, 0.1, 0.5, 1.0 };
+
+    printf("\n%10s %10s %12s %14s\n", "capacity", "occupied", "us/update", "ns/particle");
+    for (int o = 0; o < (int)(sizeof(occupancies) / sizeof(occupancies[0])); o++)
+    {
+        size_t live = (size_t)(capacity * occupancies[o]);
+        double seconds = particles_bench_occupancy(capacity, live, 2000);
+        if (seconds < 0.0)
+            return -1;
+
+        printf("%10zu %9.1f%% %12.2f %14.2f\n", capacity, occupancies[o] * 100.0, seconds * 1e6,
+            live > 0 ? seconds * 1e9 / live : 0.0);
+    }
+
+    const size_t bursts[] = { 100, 10000, 1000000 };
+
+    printf("\n%10s %16s %14s\n", "burst", "Mspawns/s", "ns/particle");
+    for (int b = 0; b < (int)(sizeof(bursts) / sizeof(bursts[0])); b++)
+    {
+        double rate = particles_bench_spawn(bursts[b], (int)(10000000 / bursts[b]));
+        if (rate < 0.0)
+            return -1;
+
+        printf("%10zu %16.1f %14.2f\n", bursts[b], rate / 1e6, 1e9 / rate);
+    }
+
+    printf("\n%10s %16s %14s\n", "particles", "quads/ms", "ns/particle");
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+    {
+        double seconds = particles_bench_quads(counts[c], (int)(20000000 / counts[c]));
+        if (seconds < 0.0)
+            return -1;
+
+        printf("%10zu %16.0f %14.2f\n", counts[c], counts[c] / seconds / 1000.0, seconds * 1e9 / counts[c]);
+    }
+
+    printf("\n%10s %14s %14s %10s %14s %17s\n", "particles", "ramp ns/p", "fade ns/p", "fade err", "gradient err", "size err");
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+    {
+        ParticleColorBench result;
+        if (particles_bench_colors(counts[c], (int)(20000000 / counts[c]), &result) != 0)
+            return -1;
+
+        printf("%10zu %14.2f %14.2f %10d %9d of %2d %7.4f of %6.4f\n", counts[c], result.ramp_seconds * 1e9 / counts[c],
+            result.fade_seconds * 1e9 / counts[c], result.fade_error, result.gradient_error, result.gradient_step,
+            result.size_error, result.size_step);
+
+        // a ramp may be off by half its steepest step, plus one for rounding
+        if (result.fade_error > 1 || result.gradient_error > result.gradient_step / 2 + 1 ||
+            result.size_error > result.size_step / 2 + 1e-6)
+        {
+            fprintf(stderr, "Particle color or size ramps are further off than their steps allow\n");
+            ret = -1;
+        }
+    }
+
+    const int threads[] = { 1, 2, 4, 8, 16 };
+    double single = 0.0;
+
+    printf("\n%10s %12s %10s %16s %10s\n", "threads", "ms/update", "speedup", "steals/update", "identical");
+    for (int t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])); t++)
+    {
+        ParticleThreadsBench result;
+        if (particles_bench_threads(1000000, threads[t], 200, &result) != 0)
+            return -1;
+        if (t == 0)
+            single = result.update_seconds;
+
+        printf("%10d %12.3f %9.2fx %16.1f %10s\n", threads[t], result.update_seconds * 1000.0,
+            single / result.update_seconds, result.steals_per_update, result.identical ? "yes" : "no");
+
+        if (!result.identical)
+        {
+            fprintf(stderr, "Particles updated on %d threads differ from the single thread update\n", threads[t]);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Benchmark modes, run from the command line without opening a window.
+// Each returns the process exit code.
+
+int bench_decode(int count, char **paths);
+int bench_segments(int count, char **paths);
+int bench_allocations(void);
+int bench_peaks(void);
+int bench_raster(void);
+int bench_fft(void);
+int bench_spectrogram(void);
+int bench_bands(void);
+int bench_beats(void);
+int bench_tap(void);
+int bench_stalls(int argc, char **argv);
+int bench_pacing(void);
+int bench_profile(void);
+int bench_particles(void);
@@ -0,0 +1,331 @@
+#include "cache.h"
+#include "segment.h"
+#include "timing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// CacheHeader starts every cache file, the samples follow it directly
+typedef struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t format;
+    uint64_t frames;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint64_t samples_hash; // hash of all samples
+    uint64_t check; // hash of the fields above and of the first and last CACHE_CHECK_BYTES of samples
+} CacheHeader;
+
+static const char cache_magic[8] = "MVIZPCM";
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t word)
+{
+    h ^= word * 0x9E3779B97F4A7C15ull;
+    h = (h << 31) | (h >> 33);
+    return h * 0xC2B2AE3D27D4EB4Full;
+}
+
+// hash_bytes is a word at a time hash, fast enough to key whole music files
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t word;
+
+    for (; size >= 8; size -= 8, p += 8)
+    {
+        memcpy(&word, p, 8);
+        h = hash_mix(h, word);
+    }
+    word = 0;
+    memcpy(&word, p, size);
+    h = hash_mix(h, word ^ size);
+
+    // final avalanche
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static uint64_t header_check(const CacheHeader *header, const unsigned char *samples, size_t bytes)
+{
+    size_t edge = bytes < CACHE_CHECK_BYTES ? bytes : CACHE_CHECK_BYTES;
+
+    uint64_t h = hash_bytes(0, header, offsetof(CacheHeader, check));
+    h = hash_bytes(h, samples, edge);
+    h = hash_bytes(h, samples + bytes - edge, edge);
+
+    return h;
+}
+
+static void cache_dir(char *dir, size_t size)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg && xdg[0])
+        snprintf(dir, size, "%s/musicviz", xdg);
+    else if (home && home[0])
+        snprintf(dir, size, "%s/.cache/musicviz", home);
+    else
+        snprintf(dir, size, "./.musicviz-cache");
+}
+
+// cache_key hashes the content of the file at path
+int cache_key(CacheKey *key, const char *path, const DecodeOptions *opts)
+{
+    const size_t block_size = 1 << 20;
+    unsigned char *block = (unsigned char *)malloc(block_size);
+    if (!block)
+        return -1;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        free(block);
+        return -1;
+    }
+
+    uint64_t h = 0;
+    uint64_t total = 0;
+    size_t n;
+    while ((n = fread(block, 1, block_size, file)) > 0)
+    {
+        h = hash_bytes(h, block, n);
+        total += n;
+    }
+    fclose(file);
+    free(block);
+
+    key->hash = h;
+    key->source_size = total;
+    key->sample_rate = opts->sample_rate;
+    key->channels = opts->channels;
+    key->format = opts->format;
+
+    char dir[900];
+    cache_dir(dir, sizeof(dir));
+    snprintf(key->path, sizeof(key->path), "%s/%016llx-%d-%d-%d.pcm", dir,
+        (unsigned long long)key->hash, key->sample_rate, key->channels, (int)key->format);
+
+    return 0;
+}
+
+// cache_load maps the cached samples for key into track.
+// entries that don't match the key or fail their checksum are removed. The checksum
+// only covers the ends of the samples so that a hit costs no more than mapping the
+// file, a CacheVerifier checks the rest while the track plays.
+CacheStatus cache_load(const CacheKey *key, Track *track)
+{
+    int fd = open(key->path, O_RDONLY);
+    if (fd < 0)
+        return CACHE_MISS;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader))
+    {
+        close(fd);
+        unlink(key->path);
+        return CACHE_INVALID;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return CACHE_MISS;
+
+    const CacheHeader *header = (const CacheHeader *)map;
+    const unsigned char *samples = (const unsigned char *)map + sizeof(CacheHeader);
+    size_t frame_size = header->channels * (size_t)sample_format_size((SampleFormat)header->format);
+    size_t bytes = (size_t)st.st_size - sizeof(CacheHeader);
+
+    bool valid = memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 &&
+        header->version == CACHE_VERSION &&
+        header->source_hash == key->hash &&
+        header->source_size == key->source_size &&
+        header->format == (uint32_t)key->format &&
+        header->channels > 0 && header->channels <= PCM_MAX_CHANNELS &&
+        header->frames * frame_size == bytes &&
+        header->check == header_check(header, samples, bytes);
+
+    if (!valid)
+    {
+        munmap(map, st.st_size);
+        unlink(key->path);
+        return CACHE_INVALID;
+    }
+
+    track_init(track, header->sample_rate, header->channels, (SampleFormat)header->format);
+    track->data = (void *)samples;
+    track->size = (int)header->frames;
+    track->capacity = track->size;
+    track->mapping = map;
+    track->mapping_size = st.st_size;
+    track->complete = true;
+
+    // the waveform and the device read the samples front to back
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    return CACHE_HIT;
+}
+
+// cache_store writes a complete track for key. the entry is written to a temporary
+// file and renamed into place so readers never see a partial entry.
+int cache_store(const CacheKey *key, const Track *track)
+{
+    char dir[900];
+    cache_dir(dir, sizeof(dir));
+    char parent[900];
+    snprintf(parent, sizeof(parent), "%s", dir);
+    char *slash = strrchr(parent, '/');
+    if (slash)
+    {
+        *slash = '\0';
+        mkdir(parent, 0755);
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+        return -1;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = CACHE_VERSION;
+    header.sample_rate = track->sample_rate;
+    header.channels = track->channels;
+    header.format = track->format;
+    header.frames = track->size;
+    header.source_hash = key->hash;
+    header.source_size = key->source_size;
+    size_t bytes = (size_t)track->size * track->frame_size;
+    header.samples_hash = hash_bytes(0, track->data, bytes);
+    header.check = header_check(&header, (const unsigned char *)track->data, bytes);
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", key->path, (long)getpid());
+    FILE *file = fopen(tmp, "wb");
+    if (!file)
+        return -1;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(track->data, 1, bytes, file) == bytes;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp, key->path) != 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void *cache_writer_thread(void *arg)
+{
+    CacheWriter *writer = (CacheWriter *)arg;
+
+    double start = now_seconds();
+    writer->status = cache_store(&writer->key, writer->track);
+    writer->seconds = now_seconds() - start;
+
+    return NULL;
+}
+
+// cache_writer_start stores the track on a background thread.
+// the track must stay untouched until cache_writer_join.
+int cache_writer_start(CacheWriter *writer, const CacheKey *key, const Track *track)
+{
+    writer->key = *key;
+    writer->track = track;
+    writer->status = 0;
+    writer->seconds = 0.0;
+    writer->running = pthread_create(&writer->thread, NULL, cache_writer_thread, writer) == 0;
+
+    return writer->running ? 0 : -1;
+}
+
+int cache_writer_join(CacheWriter *writer)
+{
+    if (!writer->running)
+        return -1;
+
+    pthread_join(writer->thread, NULL);
+    writer->running = false;
+
+    return writer->status;
+}
+
+static void *cache_verifier_thread(void *arg)
+{
+    CacheVerifier *verifier = (CacheVerifier *)arg;
+    const Track *track = verifier->track;
+    const CacheHeader *header = (const CacheHeader *)track->mapping;
+
+    double start = now_seconds();
+    size_t bytes = (size_t)track->size * track->frame_size;
+    bool valid = hash_bytes(0, track->data, bytes) == header->samples_hash;
+    verifier->seconds = now_seconds() - start;
+    if (valid)
+    {
+        atomic_store(&verifier->status, CACHE_VERIFY_OK);
+        return NULL;
+    }
+
+    // the track still maps the removed file, the rebuilt entry is for later runs
+    unlink(verifier->key.path);
+    atomic_store(&verifier->status, CACHE_VERIFY_REBUILDING);
+
+    Track fresh;
+    int status = CACHE_VERIFY_FAILED;
+    if (decode_file_segmented(verifier->source, &verifier->options, 1, &fresh) == 0)
+    {
+        if (cache_store(&verifier->key, &fresh) == 0)
+            status = CACHE_VERIFY_REBUILT;
+        track_free(&fresh);
+    }
+    atomic_store(&verifier->status, status);
+
+    return NULL;
+}
+
+// cache_verifier_start checks the track cache_load mapped for key on a background thread.
+// source and opts are what the track was decoded from, for the rebuild.
+// the track must stay mapped until cache_verifier_join.
+int cache_verifier_start(CacheVerifier *verifier, const CacheKey *key, const Track *track, const char *source, const DecodeOptions *opts)
+{
+    verifier->key = *key;
+    verifier->track = track;
+    snprintf(verifier->source, sizeof(verifier->source), "%s", source);
+    verifier->options = *opts;
+    verifier->seconds = 0.0;
+    atomic_store(&verifier->status, CACHE_VERIFY_RUNNING);
+    verifier->running = track->mapping && pthread_create(&verifier->thread, NULL, cache_verifier_thread, verifier) == 0;
+
+    return verifier->running ? 0 : -1;
+}
+
+CacheVerifyStatus cache_verifier_status(CacheVerifier *verifier)
+{
+    return (CacheVerifyStatus)atomic_load(&verifier->status);
+}
+
+// cache_verifier_join waits for the check, and for the rebuild when one was needed
+CacheVerifyStatus cache_verifier_join(CacheVerifier *verifier)
+{
+    if (verifier->running)
+    {
+        pthread_join(verifier->thread, NULL);
+        verifier->running = false;
+    }
+
+    return cache_verifier_status(verifier);
+}
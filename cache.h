@@ -0,0 +1,80 @@
+#pragma once
+
+#include "decode.h"
+#include "track.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Decoded tracks are cached on disk and memory mapped on later runs,
+// so the samples live in the page cache instead of the heap.
+
+#define CACHE_VERSION 2
+// bytes at both ends of the samples covered by the header checksum, checked on load.
+// all samples are checked afterwards by a CacheVerifier.
+#define CACHE_CHECK_BYTES 65536
+
+typedef enum CacheStatus
+{
+    CACHE_HIT = 0,
+    CACHE_MISS,
+    CACHE_INVALID // stale or corrupt entry, it was removed
+} CacheStatus;
+
+// CacheKey identifies a decoded track by the content of its file and the decode options
+typedef struct CacheKey
+{
+    uint64_t hash;
+    uint64_t source_size;
+    int sample_rate;
+    int channels;
+    SampleFormat format;
+    char path[1024]; // cache file for this key
+} CacheKey;
+
+// CacheWriter stores a complete track in the background
+typedef struct CacheWriter
+{
+    CacheKey key;
+    const Track *track;
+    pthread_t thread;
+    bool running;
+    int status;
+    double seconds;
+} CacheWriter;
+
+int cache_key(CacheKey *key, const char *path, const DecodeOptions *opts);
+CacheStatus cache_load(const CacheKey *key, Track *track);
+int cache_store(const CacheKey *key, const Track *track);
+
+int cache_writer_start(CacheWriter *writer, const CacheKey *key, const Track *track);
+int cache_writer_join(CacheWriter *writer);
+
+typedef enum CacheVerifyStatus
+{
+    CACHE_VERIFY_RUNNING = 0,
+    CACHE_VERIFY_OK,
+    CACHE_VERIFY_REBUILDING, // samples didn't match, the entry was removed and is decoded again
+    CACHE_VERIFY_REBUILT,
+    CACHE_VERIFY_FAILED, // the rebuild failed, the next run decodes the file
+} CacheVerifyStatus;
+
+// CacheVerifier hashes all samples of a mapped entry in the background and rebuilds the
+// entry from the source file when they don't match the hash it was written with.
+// The track keeps the mapped samples either way.
+typedef struct CacheVerifier
+{
+    CacheKey key;
+    const Track *track;
+    char source[1024];
+    DecodeOptions options;
+    pthread_t thread;
+    bool running;
+    _Atomic int status; // a CacheVerifyStatus
+    double seconds;
+} CacheVerifier;
+
+int cache_verifier_start(CacheVerifier *verifier, const CacheKey *key, const Track *track, const char *source, const DecodeOptions *opts);
+CacheVerifyStatus cache_verifier_status(CacheVerifier *verifier);
+CacheVerifyStatus cache_verifier_join(CacheVerifier *verifier);
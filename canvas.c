@@ -0,0 +1,455 @@
+#include "canvas.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// raylib's default font is 10 pixels high and text sizes scale from that,
+// the built in 5x7 glyphs sit on the same grid one row below the top
+#define FONT_BASE_SIZE 10
+#define FONT_TOP 1
+#define FONT_ROWS 7
+#define FONT_FIRST ' '
+#define FONT_LAST '~'
+#define FONT_SPACE_WIDTH 3
+
+// one byte per row, bit 4 is the leftmost column
+static const unsigned char font[FONT_LAST - FONT_FIRST + 1][FONT_ROWS] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // '!'
+    { 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 }, // '"'
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A }, // '#'
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 }, // '$'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, // '&'
+    { 0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '''
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 }, // '*'
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ','
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // '.'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // '0'
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // '1'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // '2'
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // '3'
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // '4'
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // '5'
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // '6'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // '8'
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // '9'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // ':'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 }, // ';'
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // '<'
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // '='
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // '>'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // '?'
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E }, // '@'
+    { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // 'A'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // 'B'
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // 'C'
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // 'D'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // 'E'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // 'F'
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // 'G'
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'H'
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // 'L'
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'O'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // 'P'
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // 'Q'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // 'R'
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // 'S'
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // 'W'
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // 'X'
+    { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // 'Y'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // 'Z'
+    { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E }, // '['
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // '\'
+    { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E }, // ']'
+    { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 }, // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, // '_'
+    { 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 }, // '`'
+    { 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F }, // 'a'
+    { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E }, // 'b'
+    { 0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E }, // 'c'
+    { 0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F }, // 'd'
+    { 0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E }, // 'e'
+    { 0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08 }, // 'f'
+    { 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E }, // 'g'
+    { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'h'
+    { 0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E }, // 'i'
+    { 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C }, // 'j'
+    { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 }, // 'k'
+    { 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 'l'
+    { 0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11 }, // 'm'
+    { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'n'
+    { 0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E }, // 'o'
+    { 0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10 }, // 'p'
+    { 0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01 }, // 'q'
+    { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 }, // 'r'
+    { 0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E }, // 's'
+    { 0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06 }, // 't'
+    { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D }, // 'u'
+    { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // 'v'
+    { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A }, // 'w'
+    { 0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11 }, // 'x'
+    { 0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E }, // 'y'
+    { 0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F }, // 'z'
+    { 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 }, // '{'
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // '|'
+    { 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 }, // '}'
+    { 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 }, // '~'
+};
+
+static inline uint32_t pack(Color color)
+{
+    uint32_t value;
+    memcpy(&value, &color, sizeof(value));
+    return value;
+}
+
+// x / 255 rounded, exact for x up to 255 * 255
+static inline int div255(int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// blends color over one pixel with the given alpha
+static inline void blend_pixel(uint32_t *dst, Color color, int alpha)
+{
+    if (alpha <= 0)
+        return;
+    if (alpha >= 255)
+    {
+        color.a = 255;
+        *dst = pack(color);
+        return;
+    }
+
+    unsigned char *d = (unsigned char *)dst;
+    int inv = 255 - alpha;
+    d[0] = div255(color.r * alpha + d[0] * inv);
+    d[1] = div255(color.g * alpha + d[1] * inv);
+    d[2] = div255(color.b * alpha + d[2] * inv);
+    d[3] = div255(255 * alpha + d[3] * inv);
+}
+
+static void fill_span(uint32_t *dst, int count, uint32_t value)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i v = _mm_set1_epi32((int)value);
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 4), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), v);
+        _mm_storeu_si128((__m128i *)(dst + i + 12), v);
+    }
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+#endif
+    for (; i < count; i++)
+        dst[i] = value;
+}
+
+// blends a translucent color over a run of pixels, four at a time with SSE2
+static void blend_span(uint32_t *dst, int count, Color color)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const int a = color.a;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src = _mm_set_epi16((short)(255 * a), (short)(color.b * a), (short)(color.g * a), (short)(color.r * a),
+        (short)(255 * a), (short)(color.b * a), (short)(color.g * a), (short)(color.r * a));
+    const __m128i inv = _mm_set1_epi16((short)(255 - a));
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+        // the sums stay below 2^16, the 16 bit lanes are used unsigned
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, inv), src), half);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, inv), src), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+        blend_pixel(dst + i, color, color.a);
+}
+
+int canvas_init(Canvas *canvas, int width, int height)
+{
+    canvas->pixels = malloc((size_t)width * height * sizeof(uint32_t));
+    if (!canvas->pixels)
+        return -1;
+    canvas->width = width;
+    canvas->height = height;
+
+    return 0;
+}
+
+void canvas_free(Canvas *canvas)
+{
+    free(canvas->pixels);
+    canvas->pixels = NULL;
+}
+
+void canvas_clear(Canvas *canvas, Color color)
+{
+    fill_span(canvas->pixels, canvas->width * canvas->height, pack(color));
+}
+
+void canvas_rectangle(Canvas *canvas, int x, int y, int width, int height, Color color)
+{
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + width > canvas->width ? canvas->width : x + width;
+    int y1 = y + height > canvas->height ? canvas->height : y + height;
+    if (x0 >= x1 || y0 >= y1 || color.a == 0)
+        return;
+
+    for (int row = y0; row < y1; row++)
+    {
+        uint32_t *dst = canvas->pixels + (size_t)row * canvas->width + x0;
+        if (color.a == 255)
+            fill_span(dst, x1 - x0, pack(color));
+        else
+            blend_span(dst, x1 - x0, color);
+    }
+}
+
+static inline void plot(Canvas *canvas, bool steep, int x, int y, Color color, float coverage)
+{
+    if (steep)
+    {
+        int t = x;
+        x = y;
+        y = t;
+    }
+    if ((unsigned)x >= (unsigned)canvas->width || (unsigned)y >= (unsigned)canvas->height)
+        return;
+
+    blend_pixel(canvas->pixels + (size_t)y * canvas->width + x, color, (int)(color.a * coverage + 0.5f));
+}
+
+// antialiased line in the manner of Wu: one pixel per step along the major axis,
+// the coverage split between the two pixels straddling the line on the minor axis.
+// with last false the pixel at end is left for the next segment of a strip.
+static void wu_line(Canvas *canvas, Vector2 start, Vector2 end, Color color, bool last)
+{
+    float x0 = start.x, y0 = start.y, x1 = end.x, y1 = end.y;
+    bool steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+    if (steep)
+    {
+        float t = x0; x0 = y0; y0 = t;
+        t = x1; x1 = y1; y1 = t;
+    }
+
+    int xa = (int)floorf(x0 + 0.5f);
+    int xb = (int)floorf(x1 + 0.5f);
+    int step = xa <= xb ? 1 : -1;
+    if (!last)
+    {
+        if (xa == xb)
+            return;
+        xb -= step;
+    }
+    if (step < 0)
+    {
+        int t = xa; xa = xb; xb = t;
+    }
+
+    float gradient = x1 != x0 ? (y1 - y0) / (x1 - x0) : 0.0f;
+
+    int extent = steep ? canvas->height : canvas->width;
+    if (xa < 0)
+        xa = 0;
+    if (xb > extent - 1)
+        xb = extent - 1;
+
+    for (int x = xa; x <= xb; x++)
+    {
+        float y = y0 + gradient * (x - x0);
+        float yi = floorf(y);
+        float f = y - yi;
+        plot(canvas, steep, x, (int)yi, color, 1.0f - f);
+        plot(canvas, steep, x, (int)yi + 1, color, f);
+    }
+}
+
+void canvas_line(Canvas *canvas, Vector2 start, Vector2 end, Color color)
+{
+    wu_line(canvas, start, end, color, true);
+}
+
+void canvas_line_strip(Canvas *canvas, const Vector2 *points, int count, Color color)
+{
+    // every joint is drawn once so translucent strips don't darken at the vertices
+    for (int i = 0; i + 1 < count; i++)
+        wu_line(canvas, points[i], points[i + 1], color, i + 2 == count);
+}
+
+static const unsigned char *glyph(unsigned char c)
+{
+    if (c < FONT_FIRST || c > FONT_LAST)
+        c = '?';
+    return font[c - FONT_FIRST];
+}
+
+// glyph_columns finds the columns a glyph uses so the text is proportional like raylib's
+static int glyph_columns(const unsigned char *rows, int *left)
+{
+    unsigned char bits = 0;
+    for (int r = 0; r < FONT_ROWS; r++)
+        bits |= rows[r];
+    if (!bits)
+    {
+        *left = 0;
+        return FONT_SPACE_WIDTH;
+    }
+
+    int first = 4, last = 0;
+    for (int col = 0; col < 5; col++)
+    {
+        if (bits & (0x10 >> col))
+        {
+            if (col < first)
+                first = col;
+            last = col;
+        }
+    }
+    *left = first;
+
+    return last - first + 1;
+}
+
+// utf-8 continuation bytes are skipped, every other character outside ascii draws as '?'
+static bool is_continuation(unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+int canvas_measure_text(const char *text, int size)
+{
+    float scale = (float)size / FONT_BASE_SIZE;
+    int spacing = size / FONT_BASE_SIZE;
+    float width = 0.0f;
+    int count = 0;
+
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (is_continuation(*c))
+            continue;
+        int left;
+        width += glyph_columns(glyph(*c), &left) * scale;
+        count++;
+    }
+
+    return count ? (int)(width + (count - 1) * spacing) : 0;
+}
+
+void canvas_text(Canvas *canvas, const char *text, int x, int y, int size, Color color)
+{
+    float scale = (float)size / FONT_BASE_SIZE;
+    int spacing = size / FONT_BASE_SIZE;
+    float pen = 0.0f;
+
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (is_continuation(*c))
+            continue;
+
+        const unsigned char *rows = glyph(*c);
+        int left;
+        int columns = glyph_columns(rows, &left);
+
+        for (int r = 0; r < FONT_ROWS; r++)
+        {
+            int top = y + (int)((FONT_TOP + r) * scale);
+            int bottom = y + (int)((FONT_TOP + r + 1) * scale);
+
+            // one rectangle per run of set pixels in the row
+            for (int col = 0; col < columns; )
+            {
+                if (!(rows[r] & (0x10 >> (left + col))))
+                {
+                    col++;
+                    continue;
+                }
+                int run = col;
+                while (run < columns && (rows[r] & (0x10 >> (left + run))))
+                    run++;
+
+                int x0 = x + (int)(pen + col * scale);
+                int x1 = x + (int)(pen + run * scale);
+                canvas_rectangle(canvas, x0, top, x1 - x0, bottom - top, color);
+                col = run;
+            }
+        }
+
+        pen += columns * scale + spacing;
+    }
+}
+
+static void cpu_clear(void *user, Color color)
+{
+    canvas_clear(user, color);
+}
+
+static void cpu_rectangle(void *user, int x, int y, int width, int height, Color color)
+{
+    canvas_rectangle(user, x, y, width, height, color);
+}
+
+static void cpu_line(void *user, Vector2 start, Vector2 end, Color color)
+{
+    canvas_line(user, start, end, color);
+}
+
+static void cpu_line_strip(void *user, const Vector2 *points, int count, Color color)
+{
+    canvas_line_strip(user, points, count, color);
+}
+
+static void cpu_text(void *user, const char *text, int x, int y, int size, Color color)
+{
+    canvas_text(user, text, x, y, size, color);
+}
+
+static int cpu_measure_text(void *user, const char *text, int size)
+{
+    (void)user;
+    return canvas_measure_text(text, size);
+}
+
+void canvas_backend(Canvas *canvas, DrawBackend *draw)
+{
+    draw->user = canvas;
+    draw->clear = cpu_clear;
+    draw->rectangle = cpu_rectangle;
+    draw->line = cpu_line;
+    draw->line_strip = cpu_line_strip;
+    draw->text = cpu_text;
+    draw->measure_text = cpu_measure_text;
+}
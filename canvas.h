@@ -0,0 +1,26 @@
+#pragma once
+
+#include "draw.h"
+
+#include <stdint.h>
+
+// Canvas is an RGBA framebuffer in memory, one byte per channel in R, G, B, A
+// order like PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, rows packed without padding.
+typedef struct Canvas
+{
+    uint32_t *pixels;
+    int width;
+    int height;
+} Canvas;
+
+int canvas_init(Canvas *canvas, int width, int height);
+void canvas_free(Canvas *canvas);
+void canvas_clear(Canvas *canvas, Color color);
+void canvas_rectangle(Canvas *canvas, int x, int y, int width, int height, Color color);
+void canvas_line(Canvas *canvas, Vector2 start, Vector2 end, Color color);
+void canvas_line_strip(Canvas *canvas, const Vector2 *points, int count, Color color);
+void canvas_text(Canvas *canvas, const char *text, int x, int y, int size, Color color);
+int canvas_measure_text(const char *text, int size);
+
+// canvas_backend draws the scene into the canvas without a window or GPU
+void canvas_backend(Canvas *canvas, DrawBackend *draw);
@@ -0,0 +1,461 @@
+#include "decode.h"
+
+#include "libavutil/opt.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+int decode_open(DecodeSource *src, const char *path, const DecodeOptions *opts)
+{
+    memset(src, 0, sizeof(*src));
+
+    // initialize all muxers, demuxers and protocols for libavformat
+    // (does nothing if called twice during the course of one program execution,
+    // and is done automatically since libavformat 58.9)
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
+
+    // get format from audio file
+    src->format = avformat_alloc_context();
+    if (avformat_open_input(&src->format, path, NULL, NULL) != 0)
+    {
+        fprintf(stderr, "Could not open file '%s'\n", path);
+        return -1;
+    }
+    if (avformat_find_stream_info(src->format, NULL) < 0)
+    {
+        fprintf(stderr, "Could not retrieve stream info from file '%s'\n", path);
+        decode_close(src);
+        return -1;
+    }
+
+    // Find the index of the first audio stream
+    src->stream_index = -1;
+    for (unsigned int i = 0; i < src->format->nb_streams; i++)
+    {
+        if (src->format->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            src->stream_index = (int)i;
+            break;
+        }
+    }
+    if (src->stream_index == -1)
+    {
+        fprintf(stderr, "Could not retrieve audio stream from file '%s'\n", path);
+        decode_close(src);
+        return -1;
+    }
+    AVStream *stream = src->format->streams[src->stream_index];
+
+    // find & open codec
+    AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec)
+    {
+        fprintf(stderr, "No decoder for stream #%u in file '%s'\n", src->stream_index, path);
+        decode_close(src);
+        return -1;
+    }
+    AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+    if (!codec_ctx)
+    {
+        fprintf(stderr, "Error allocating the decoder context\n");
+        decode_close(src);
+        return -1;
+    }
+    src->codec_ctx = codec_ctx;
+    if (avcodec_parameters_to_context(codec_ctx, stream->codecpar) < 0)
+    {
+        fprintf(stderr, "Could not copy codec parameters of stream #%u in file '%s'\n", src->stream_index, path);
+        decode_close(src);
+        return -1;
+    }
+
+    // pick the threading model from what the decoder actually supports.
+    // a thread_count of 0 lets the codec determine how many threads suit the decoding job best
+    codec_ctx->thread_count = opts->threads;
+    if (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)
+        codec_ctx->thread_type = FF_THREAD_FRAME;
+    else if (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)
+        codec_ctx->thread_type = FF_THREAD_SLICE;
+    else
+        codec_ctx->thread_count = 1; // don't use multithreading
+
+    if (avcodec_open2(codec_ctx, codec, NULL) < 0)
+    {
+        fprintf(stderr, "Failed to open decoder for stream #%u in file '%s'\n", src->stream_index, path);
+        decode_close(src);
+        return -1;
+    }
+    src->thread_count = codec_ctx->thread_count;
+    src->thread_type = codec_ctx->thread_count > 1 ? codec_ctx->active_thread_type : 0;
+
+    src->channel_count = codec_ctx->channels;
+    src->channels = opts->channels > 0 ? opts->channels : codec_ctx->channels;
+    if (src->channels > PCM_MAX_CHANNELS)
+        src->channels = PCM_MAX_CHANNELS;
+    src->sample_rate = opts->sample_rate > 0 ? opts->sample_rate : codec_ctx->sample_rate;
+    src->sample_format = opts->format;
+    src->frame_size = src->channels * sample_format_size(opts->format);
+    enum AVSampleFormat out_fmt = opts->format == SAMPLE_FORMAT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+    if (src->format->duration != AV_NOPTS_VALUE)
+        src->duration = (double)src->format->duration / AV_TIME_BASE;
+    src->range_start = INT64_MIN;
+    src->range_end = INT64_MAX;
+    src->first_pos = -1;
+    src->next_pos = decode_start_pos(src);
+
+    // some decoders leave the layout unset, fall back to the default one for the channel count
+    int64_t in_layout = codec_ctx->channel_layout;
+    if (!in_layout)
+        in_layout = av_get_default_channel_layout(codec_ctx->channels);
+
+    // prepare resampler
+    struct SwrContext* swr = swr_alloc();
+    av_opt_set_int(swr, "in_channel_count",  codec_ctx->channels, 0);
+    av_opt_set_int(swr, "out_channel_count", src->channels, 0);
+    av_opt_set_int(swr, "in_channel_layout",  in_layout, 0);
+    av_opt_set_int(swr, "out_channel_layout", av_get_default_channel_layout(src->channels), 0);
+    av_opt_set_int(swr, "in_sample_rate", codec_ctx->sample_rate, 0);
+    av_opt_set_int(swr, "out_sample_rate", src->sample_rate, 0);
+    av_opt_set_sample_fmt(swr, "in_sample_fmt",  codec_ctx->sample_fmt, 0);
+    av_opt_set_sample_fmt(swr, "out_sample_fmt", out_fmt,  0);
+    swr_init(swr);
+    src->swr = swr;
+    if (!swr_is_initialized(swr))
+    {
+        fprintf(stderr, "Resampler has not been properly initialized\n");
+        decode_close(src);
+        return -1;
+    }
+
+    // prepare to read data
+    src->frame = av_frame_alloc();
+    if (!src->frame)
+    {
+        fprintf(stderr, "Error allocating the frame\n");
+        decode_close(src);
+        return -1;
+    }
+
+    return 0;
+}
+
+// resamples in_count input frames and hands output frames [skip, keep) to the sink.
+// passing NULL flushes the samples buffered in the resampler.
+static int decode_emit(DecodeSource *src, const uint8_t **in, int in_count, int skip, int keep, DecodeSink sink, void *user)
+{
+    // resample into the scratch buffer, which only grows when a frame is bigger than any before
+    int out_count = swr_get_out_samples(src->swr, in_count);
+    if (out_count <= 0)
+        return 0;
+    if (out_count > src->buffer_frames)
+    {
+        av_freep(&src->buffer);
+        enum AVSampleFormat out_fmt = src->sample_format == SAMPLE_FORMAT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+        if (av_samples_alloc(&src->buffer, NULL, src->channels, out_count, out_fmt, 0) < 0)
+        {
+            src->buffer_frames = 0;
+            return -1;
+        }
+        src->buffer_frames = out_count;
+        src->allocations++;
+    }
+
+    int frame_count = swr_convert(src->swr, &src->buffer, src->buffer_frames, in, in_count);
+    if (frame_count < 0)
+        return -1;
+    if (keep > frame_count)
+        keep = frame_count;
+
+    // hand resampled frames to the sink
+    if (keep > skip && sink(user, src->buffer + (size_t)skip * src->frame_size, keep - skip) != 0)
+        return -1;
+
+    return 0;
+}
+
+// passes every frame the decoder has ready on to the resampler.
+// returns 1 once the frames are past range_end.
+static int decode_receive(DecodeSource *src, DecodeSink sink, void *user)
+{
+    int ret;
+
+    while ((ret = avcodec_receive_frame(src->codec_ctx, src->frame)) >= 0)
+    {
+        AVFrame *frame = src->frame;
+
+        // place the frame on the stream timeline, counting samples when there is no timestamp
+        int64_t pos = src->next_pos;
+        if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+        {
+            AVRational time_base = src->format->streams[src->stream_index]->time_base;
+            pos = av_rescale_q(frame->best_effort_timestamp, time_base, (AVRational){ 1, src->codec_ctx->sample_rate });
+        }
+        src->next_pos = pos + frame->nb_samples;
+
+        if (pos >= src->range_end)
+        {
+            av_frame_unref(frame);
+            return 1;
+        }
+
+        int skip = pos < src->range_start ? (int)FFMIN(src->range_start - pos, frame->nb_samples) : 0;
+        int keep = pos + frame->nb_samples > src->range_end ? (int)(src->range_end - pos) : INT_MAX;
+        if (src->first_pos < 0 && skip < frame->nb_samples)
+            src->first_pos = pos + skip;
+
+        int err = decode_emit(src, (const uint8_t **)frame->extended_data, frame->nb_samples, skip, keep, sink, user);
+        av_frame_unref(frame);
+        if (err != 0)
+            return err;
+    }
+
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+int decode_run(DecodeSource *src, DecodeSink sink, void *user)
+{
+    AVPacket *packet = av_packet_alloc();
+    if (!packet)
+        return -1;
+
+    // iterate through packets
+    int read_status;
+    while ((read_status = av_read_frame(src->format, packet)) >= 0)
+    {
+        if (packet->stream_index != src->stream_index)
+        {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        // EAGAIN means the decoder wants its frames taken before it accepts the packet,
+        // any other error is a broken stream and not the end of the file
+        int sent = avcodec_send_packet(src->codec_ctx, packet);
+        int ret = 0;
+        while (sent == AVERROR(EAGAIN) && (ret = decode_receive(src, sink, user)) == 0)
+            sent = avcodec_send_packet(src->codec_ctx, packet);
+        av_packet_unref(packet);
+        if (ret == 0 && sent < 0)
+        {
+            fprintf(stderr, "Error decoding packet: %s\n", av_err2str(sent));
+            av_packet_free(&packet);
+            return -1;
+        }
+        if (ret == 0)
+            ret = decode_receive(src, sink, user);
+        if (ret != 0)
+        {
+            av_packet_free(&packet);
+            return ret > 0 ? 0 : -1;
+        }
+    }
+    av_packet_free(&packet);
+    if (read_status != AVERROR_EOF)
+    {
+        fprintf(stderr, "Error reading packet: %s\n", av_err2str(read_status));
+        return -1;
+    }
+
+    // drain the frames still held by the decoder threads, then the resampler
+    avcodec_send_packet(src->codec_ctx, NULL);
+    int ret = decode_receive(src, sink, user);
+    if (ret != 0)
+    {
+        return ret > 0 ? 0 : -1;
+    }
+
+    return decode_emit(src, NULL, 0, 0, INT_MAX, sink, user);
+}
+
+// decode_start_pos returns the position of the first sample of the stream, in samples of the file
+int64_t decode_start_pos(const DecodeSource *src)
+{
+    AVStream *stream = src->format->streams[src->stream_index];
+    if (stream->start_time == AV_NOPTS_VALUE)
+        return 0;
+
+    return av_rescale_q(stream->start_time, stream->time_base, (AVRational){ 1, src->codec_ctx->sample_rate });
+}
+
+// decode_seek moves to the closest point at or before pos (in samples of the file)
+int decode_seek(DecodeSource *src, int64_t pos)
+{
+    AVStream *stream = src->format->streams[src->stream_index];
+    int64_t ts = av_rescale_q(pos, (AVRational){ 1, src->codec_ctx->sample_rate }, stream->time_base);
+
+    if (av_seek_frame(src->format, src->stream_index, ts, AVSEEK_FLAG_BACKWARD) < 0)
+        return -1;
+    avcodec_flush_buffers(src->codec_ctx);
+    src->next_pos = pos;
+
+    return 0;
+}
+
+void decode_close(DecodeSource *src)
+{
+    av_freep(&src->buffer);
+    src->buffer_frames = 0;
+    av_frame_free(&src->frame);
+    swr_free(&src->swr);
+    avcodec_free_context(&src->codec_ctx);
+    avformat_close_input(&src->format);
+}
+
+// decode_expected_frames estimates the number of output frames from the container duration,
+// 0 if the duration is unknown
+int decode_expected_frames(const DecodeSource *src)
+{
+    return (int)(src->duration * src->sample_rate);
+}
+
+// track_sink is a DecodeSink appending to the Track passed as user
+int track_sink(void *user, const void *samples, int frames)
+{
+    return track_append((Track *)user, samples, frames);
+}
+
+// decodes the whole file into mono samples of the given format
+int decode_audio_file(const char *path, const int sample_rate, const SampleFormat format, int *channel_count, void **data, int *size)
+{
+    DecodeOptions opts = { .sample_rate = sample_rate, .channels = 1, .format = format, .threads = 0 };
+    DecodeSource src;
+    if (decode_open(&src, path, &opts) != 0)
+    {
+        return -1;
+    }
+    *channel_count = src.channel_count;
+
+    Track track;
+    track_init(&track, src.sample_rate, 1, format);
+    track_reserve(&track, decode_expected_frames(&src));
+    int ret = decode_run(&src, track_sink, &track);
+    decode_close(&src);
+
+    *data = track.data;
+    *size = track.size;
+
+    return ret;
+}
+
+// copies decoded samples into ring chunks, blocking while the ring is full
+static int ring_sink(void *user, const void *samples, int frames)
+{
+    Decoder *dec = (Decoder *)user;
+    const unsigned char *bytes = (const unsigned char *)samples;
+    int frame_size = dec->source.frame_size;
+
+    while (frames > 0)
+    {
+        if (!dec->pending)
+        {
+            dec->pending = pcm_ring_acquire(&dec->ring);
+            if (!dec->pending)
+                return -1; // consumer closed the ring
+        }
+
+        PcmChunk *chunk = dec->pending;
+        int n = PCM_CHUNK_FRAMES - chunk->frames;
+        if (n > frames)
+            n = frames;
+        memcpy(chunk->samples + chunk->frames * frame_size, bytes, n * frame_size);
+        chunk->frames += n;
+        bytes += n * frame_size;
+        frames -= n;
+
+        if (chunk->frames == PCM_CHUNK_FRAMES)
+        {
+            pcm_ring_commit(&dec->ring);
+            dec->pending = NULL;
+        }
+    }
+
+    return 0;
+}
+
+static void *decoder_thread(void *arg)
+{
+    Decoder *dec = (Decoder *)arg;
+
+    dec->status = decode_run(&dec->source, ring_sink, dec);
+
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    dec->cpu_seconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+
+    // flush the last partially filled chunk
+    if (dec->pending && dec->pending->frames > 0)
+        pcm_ring_commit(&dec->ring);
+    dec->pending = NULL;
+    pcm_ring_finish(&dec->ring);
+
+    return NULL;
+}
+
+int decoder_start(Decoder *dec, const char *path, const DecodeOptions *opts)
+{
+    if (decode_open(&dec->source, path, opts) != 0)
+    {
+        return -1;
+    }
+
+    pcm_ring_init(&dec->ring);
+    dec->pending = NULL;
+    dec->status = 0;
+    dec->cpu_seconds = 0.0;
+
+    if (pthread_create(&dec->thread, NULL, decoder_thread, dec) != 0)
+    {
+        fprintf(stderr, "Could not start decode thread for '%s'\n", path);
+        pcm_ring_destroy(&dec->ring);
+        decode_close(&dec->source);
+        return -1;
+    }
+
+    return 0;
+}
+
+// moves every chunk decoded so far into the track without blocking.
+// returns the number of samples appended.
+int decoder_drain(Decoder *dec, Track *track)
+{
+    int appended = 0;
+    const PcmChunk *chunk;
+
+    while ((chunk = pcm_ring_peek(&dec->ring)) != NULL)
+    {
+        if (track_append(track, chunk->samples, chunk->frames) != 0)
+            break;
+        appended += chunk->frames;
+        pcm_ring_release(&dec->ring);
+    }
+
+    // a failed decode leaves the track incomplete so it is never taken for the whole file
+    if (pcm_ring_done(&dec->ring) && dec->status == 0)
+        track->complete = true;
+
+    return appended;
+}
+
+bool decoder_done(Decoder *dec)
+{
+    return pcm_ring_done(&dec->ring);
+}
+
+// decoder_status is the result of decode_run, 0 until decoder_done
+int decoder_status(Decoder *dec)
+{
+    return decoder_done(dec) ? dec->status : 0;
+}
+
+void decoder_stop(Decoder *dec)
+{
+    pcm_ring_close(&dec->ring);
+    pthread_join(dec->thread, NULL);
+    pcm_ring_destroy(&dec->ring);
+    decode_close(&dec->source);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "libswresample/swresample.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+
+#include "pcm_ring.h"
+#include "track.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// DecodeSink receives every block of resampled interleaved frames.
+// Returning non zero stops decoding.
+typedef int (*DecodeSink)(void *user, const void *samples, int frames);
+
+// DecodeOptions selects what the decoder produces
+typedef struct DecodeOptions
+{
+    int sample_rate; // 0 keeps the sample rate of the file
+    int channels; // 0 keeps the channels of the file, capped at PCM_MAX_CHANNELS
+    SampleFormat format;
+    int threads; // decoder threads, 0 lets FFmpeg decide
+} DecodeOptions;
+
+// DecodeSource is an opened audio file ready to be decoded and resampled.
+typedef struct DecodeSource
+{
+    AVFormatContext *format;
+    AVCodecContext *codec_ctx;
+    struct SwrContext *swr;
+    AVFrame *frame;
+    uint8_t *buffer; // resampler output, reused for every frame
+    int buffer_frames;
+    int allocations; // number of times buffer was (re)allocated
+    int stream_index;
+    int thread_type; // FF_THREAD_FRAME, FF_THREAD_SLICE or 0 when decoding on one thread
+    int thread_count; // threads actually used by the decoder
+    int channel_count; // channels in the file
+    int channels; // channels after resampling
+    int sample_rate; // sample rate after resampling
+    SampleFormat sample_format; // sample format after resampling
+    int frame_size; // bytes per resampled interleaved frame
+    double duration; // in seconds, 0 if the container doesn't know
+    // optional window of stream positions (in samples of the file) handed to the sink,
+    // only exact when the sample rate is not converted
+    int64_t range_start;
+    int64_t range_end;
+    int64_t first_pos; // position of the first sample handed to the sink, -1 before that
+    int64_t next_pos; // expected position of the next decoded frame
+} DecodeSource;
+
+int decode_open(DecodeSource *src, const char *path, const DecodeOptions *opts);
+int decode_run(DecodeSource *src, DecodeSink sink, void *user);
+void decode_close(DecodeSource *src);
+int decode_expected_frames(const DecodeSource *src);
+int track_sink(void *user, const void *samples, int frames);
+int64_t decode_start_pos(const DecodeSource *src);
+int decode_seek(DecodeSource *src, int64_t pos);
+
+int decode_audio_file(const char *path, const int sample_rate, const SampleFormat format, int *channel_count, void **data, int *size);
+
+// Decoder decodes a file on a background thread, keeping at most
+// PCM_RING_CHUNKS chunks ahead of the consumer.
+typedef struct Decoder
+{
+    DecodeSource source;
+    PcmRing ring;
+    PcmChunk *pending; // chunk currently being filled by the decode thread
+    pthread_t thread;
+    int status; // result of decode_run, valid once the ring is done
+    double cpu_seconds; // CPU time used by the decode thread, valid once the ring is done
+} Decoder;
+
+int decoder_start(Decoder *dec, const char *path, const DecodeOptions *opts);
+int decoder_drain(Decoder *dec, Track *track);
+bool decoder_done(Decoder *dec);
+int decoder_status(Decoder *dec);
+void decoder_stop(Decoder *dec);
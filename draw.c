@@ -0,0 +1,52 @@
+#include "draw.h"
+
+#include <stddef.h>
+
+// the raylib window, everything goes through its batched GL renderer
+
+static void gl_clear(void *user, Color color)
+{
+    (void)user;
+    ClearBackground(color);
+}
+
+static void gl_rectangle(void *user, int x, int y, int width, int height, Color color)
+{
+    (void)user;
+    DrawRectangle(x, y, width, height, color);
+}
+
+static void gl_line(void *user, Vector2 start, Vector2 end, Color color)
+{
+    (void)user;
+    DrawLineV(start, end, color);
+}
+
+static void gl_line_strip(void *user, const Vector2 *points, int count, Color color)
+{
+    (void)user;
+    DrawLineStrip((Vector2 *)points, count, color);
+}
+
+static void gl_text(void *user, const char *text, int x, int y, int size, Color color)
+{
+    (void)user;
+    DrawText(text, x, y, size, color);
+}
+
+static int gl_measure_text(void *user, const char *text, int size)
+{
+    (void)user;
+    return MeasureText(text, size);
+}
+
+void draw_backend_gl(DrawBackend *draw)
+{
+    draw->user = NULL;
+    draw->clear = gl_clear;
+    draw->rectangle = gl_rectangle;
+    draw->line = gl_line;
+    draw->line_strip = gl_line_strip;
+    draw->text = gl_text;
+    draw->measure_text = gl_measure_text;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "raylib.h"
+
+// DrawBackend is the set of primitives a frame is drawn with, so the same
+// scene can go to the window or to a framebuffer in memory.
+typedef struct DrawBackend
+{
+    void *user;
+    void (*clear)(void *user, Color color);
+    void (*rectangle)(void *user, int x, int y, int width, int height, Color color);
+    void (*line)(void *user, Vector2 start, Vector2 end, Color color);
+    void (*line_strip)(void *user, const Vector2 *points, int count, Color color);
+    void (*text)(void *user, const char *text, int x, int y, int size, Color color);
+    int (*measure_text)(void *user, const char *text, int size);
+} DrawBackend;
+
+void draw_backend_gl(DrawBackend *draw);
@@ -0,0 +1,200 @@
+#include "fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+int fft_init(Fft *fft, int size)
+{
+    memset(fft, 0, sizeof(*fft));
+    if (size < FFT_MIN_SIZE || size > FFT_MAX_SIZE || (size & (size - 1)) != 0)
+        return -1;
+
+    int half = size / 2;
+    fft->size = size;
+    fft->bins = half + 1;
+    fft->window = malloc(sizeof(float) * size);
+    fft->bitrev = malloc(sizeof(int) * half);
+    fft->twiddle_re = malloc(sizeof(float) * half);
+    fft->twiddle_im = malloc(sizeof(float) * half);
+    fft->post_re = malloc(sizeof(float) * fft->bins);
+    fft->post_im = malloc(sizeof(float) * fft->bins);
+    fft->re = malloc(sizeof(float) * half);
+    fft->im = malloc(sizeof(float) * half);
+    fft->out_re = malloc(sizeof(float) * fft->bins);
+    fft->out_im = malloc(sizeof(float) * fft->bins);
+    if (!fft->window || !fft->bitrev || !fft->twiddle_re || !fft->twiddle_im || !fft->post_re
+        || !fft->post_im || !fft->re || !fft->im || !fft->out_re || !fft->out_im)
+    {
+        fft_free(fft);
+        return -1;
+    }
+
+    fft->window_gain = 0.0f;
+    for (int i = 0; i < size; i++)
+    {
+        fft->window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / size);
+        fft->window_gain += fft->window[i];
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half)
+        bits++;
+    for (int i = 0; i < half; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        fft->bitrev[i] = r;
+    }
+
+    // each stage gets its own contiguous run of twiddles so the butterflies load them linearly
+    for (int h = 1; h < half; h *= 2)
+    {
+        for (int k = 0; k < h; k++)
+        {
+            fft->twiddle_re[h - 1 + k] = cos(M_PI * k / h);
+            fft->twiddle_im[h - 1 + k] = -sin(M_PI * k / h);
+        }
+    }
+
+    for (int k = 0; k < fft->bins; k++)
+    {
+        fft->post_re[k] = cos(2.0 * M_PI * k / size);
+        fft->post_im[k] = -sin(2.0 * M_PI * k / size);
+    }
+
+    return 0;
+}
+
+// fft_simd names the butterflies this build runs
+const char *fft_simd(void)
+{
+#if defined(__AVX__)
+    return "avx";
+#elif defined(__SSE__)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+// radix 2 butterflies of one stage, span h, on split real and imaginary arrays
+static void fft_stage(float *re, float *im, int n, int h, const float *wr, const float *wi)
+{
+    for (int base = 0; base < n; base += 2 * h)
+    {
+        float *ar = re + base, *ai = im + base;
+        float *br = ar + h, *bi = ai + h;
+        int j = 0;
+#if defined(__AVX__)
+        for (; j + 8 <= h; j += 8)
+        {
+            __m256 xr = _mm256_loadu_ps(br + j), xi = _mm256_loadu_ps(bi + j);
+            __m256 wre = _mm256_loadu_ps(wr + j), wim = _mm256_loadu_ps(wi + j);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, wre), _mm256_mul_ps(xi, wim));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, wim), _mm256_mul_ps(xi, wre));
+            __m256 yr = _mm256_loadu_ps(ar + j), yi = _mm256_loadu_ps(ai + j);
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(yr, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(yi, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(yr, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(yi, ti));
+        }
+#endif
+#if defined(__SSE__)
+        for (; j + 4 <= h; j += 4)
+        {
+            __m128 xr = _mm_loadu_ps(br + j), xi = _mm_loadu_ps(bi + j);
+            __m128 wre = _mm_loadu_ps(wr + j), wim = _mm_loadu_ps(wi + j);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wre), _mm_mul_ps(xi, wim));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wim), _mm_mul_ps(xi, wre));
+            __m128 yr = _mm_loadu_ps(ar + j), yi = _mm_loadu_ps(ai + j);
+            _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+        }
+#endif
+        for (; j < h; j++)
+        {
+            float tr = br[j] * wr[j] - bi[j] * wi[j];
+            float ti = br[j] * wi[j] + bi[j] * wr[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+
+// fft_forward windows size real samples and writes the bins complex values of their spectrum
+void fft_forward(Fft *fft, const float *input, float *out_re, float *out_im)
+{
+    const int half = fft->size / 2;
+    float *re = fft->re;
+    float *im = fft->im;
+
+    // even samples as the real part, odd ones as the imaginary part, in bit reversed order
+    for (int i = 0; i < half; i++)
+    {
+        int n = 2 * fft->bitrev[i];
+        re[i] = input[n] * fft->window[n];
+        im[i] = input[n + 1] * fft->window[n + 1];
+    }
+
+    for (int h = 1; h < half; h *= 2)
+        fft_stage(re, im, half, h, fft->twiddle_re + h - 1, fft->twiddle_im + h - 1);
+
+    // untangle the spectra of the even and odd samples
+    for (int k = 0; k <= half; k++)
+    {
+        int a = k == half ? 0 : k;
+        int b = k == 0 ? 0 : half - k;
+        float zr = re[a], zi = im[a];
+        float cr = re[b], ci = -im[b];
+        float even_re = 0.5f * (zr + cr), even_im = 0.5f * (zi + ci);
+        float odd_re = 0.5f * (zi - ci), odd_im = -0.5f * (zr - cr);
+        out_re[k] = even_re + fft->post_re[k] * odd_re - fft->post_im[k] * odd_im;
+        out_im[k] = even_im + fft->post_re[k] * odd_im + fft->post_im[k] * odd_re;
+    }
+}
+
+// fft_magnitude writes the bins amplitudes of the input, a full scale sine reads 1
+void fft_magnitude(Fft *fft, const float *input, float *magnitude)
+{
+    fft_forward(fft, input, fft->out_re, fft->out_im);
+
+    float scale = 2.0f / fft->window_gain;
+    for (int k = 0; k < fft->bins; k++)
+        magnitude[k] = sqrtf(fft->out_re[k] * fft->out_re[k] + fft->out_im[k] * fft->out_im[k]) * scale;
+}
+
+void fft_decibels(const float *magnitude, float *db, int count, float floor_db)
+{
+    for (int k = 0; k < count; k++)
+    {
+        float value = magnitude[k] > 1e-10f ? 20.0f * log10f(magnitude[k]) : floor_db;
+        db[k] = value < floor_db ? floor_db : value;
+    }
+}
+
+void fft_free(Fft *fft)
+{
+    free(fft->window);
+    free(fft->bitrev);
+    free(fft->twiddle_re);
+    free(fft->twiddle_im);
+    free(fft->post_re);
+    free(fft->post_im);
+    free(fft->re);
+    free(fft->im);
+    free(fft->out_re);
+    free(fft->out_im);
+    memset(fft, 0, sizeof(*fft));
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#define FFT_MIN_SIZE 512
+#define FFT_MAX_SIZE 16384
+
+// Fft is a windowed real input FFT of a fixed power of two size, computed as a
+// complex FFT of half the size. Every table is built once by fft_init.
+typedef struct Fft
+{
+    int size; // real input samples
+    int bins; // size / 2 + 1 complex outputs, DC to Nyquist
+    float *window; // Hann window, size values
+    float window_gain; // sum of the window, to normalize magnitudes
+    int *bitrev; // input permutation of the size / 2 point complex FFT
+    float *twiddle_re; // per stage twiddles of the complex FFT, the stage of span h at offset h - 1
+    float *twiddle_im;
+    float *post_re; // e^(-2 pi i k / size), splits the half size result into the real spectrum
+    float *post_im;
+    float *re; // scratch of the complex FFT, size / 2 values
+    float *im;
+    float *out_re; // spectrum of the last fft_magnitude, bins values
+    float *out_im;
+} Fft;
+
+int fft_init(Fft *fft, int size);
+void fft_forward(Fft *fft, const float *input, float *out_re, float *out_im);
+void fft_magnitude(Fft *fft, const float *input, float *magnitude);
+void fft_decibels(const float *magnitude, float *db, int count, float floor_db);
+void fft_free(Fft *fft);
+const char *fft_simd(void);
@@ -68,6 +68,12 @@ typedef struct Particle Particle;
 typedef struct EmitterConfig EmitterConfig;
 typedef struct Emitter Emitter;
 typedef struct ParticleSystem ParticleSystem;
+typedef struct EmitterRandom EmitterRandom;
+
+// A ParticleSystem_Runner calls job(user, j) for every j in [0, jobs), on any threads and in
+// any order, and returns when all calls have returned.
+typedef void (*ParticleSystem_Job)(void *user, int job);
+typedef void (*ParticleSystem_Runner)(void *runner, ParticleSystem_Job job, void *user, int jobs);
 
 
 // Function signatures (comments are found in implementation below)
@@ -77,6 +83,9 @@ Vector2 NormalizeV2(Vector2 v);
 Vector2 RotateV2(Vector2 v, float degrees);
 Color LinearFade(Color c1, Color c2, float fraction);
 
+void EmitterRandom_Seed(EmitterRandom *r, unsigned long long seed);
+void EmitterRandom_Fill(EmitterRandom *r, float *out, unsigned long count);
+
 bool Particle_DeactivatorAge(Particle *p);
 Particle * Particle_New(bool (*deactivatorFunc)(struct Particle *));
 void Particle_Free(Particle *p);
@@ -90,6 +99,7 @@ void Emitter_Stop(Emitter *e);
 void Emitter_Free(Emitter *e);
 void Emitter_Burst(Emitter *e);
 unsigned long Emitter_Update(Emitter *e, float dt);
+unsigned long Emitter_UpdateReference(Emitter *e, float dt);
 void Emitter_Draw(Emitter *e);
 
 ParticleSystem * ParticleSystem_New(void);
@@ -100,6 +110,7 @@ void ParticleSystem_Start(ParticleSystem *ps);
 void ParticleSystem_Stop(ParticleSystem *ps);
 void ParticleSystem_Burst(ParticleSystem *ps);
 void ParticleSystem_Draw(ParticleSystem *ps);
+void ParticleSystem_SetRunner(ParticleSystem *ps, ParticleSystem_Runner run, void *runner);
 unsigned long ParticleSystem_Update(ParticleSystem *ps, float dt);
 void ParticleSystem_Free(ParticleSystem *p);
 
@@ -107,8 +118,25 @@ void ParticleSystem_Free(ParticleSystem *p);
 #ifdef LIBPARTIKEL_IMPLEMENTATION
 
 #include "stdlib.h"
+#include "stdint.h"
+#include "string.h"
 #include "math.h"
 
+// From rlgl.h, which comes with raylib. Draws what raylib has batched so far.
+void rlDrawRenderBatchActive(void);
+
+// The emitter integrator advances 8 particles at a time with AVX and 4 with SSE2,
+// picked when compiling. Other targets use the scalar one.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EMITTER_LANES 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EMITTER_LANES 4
+#else
+#define EMITTER_LANES 1
+#endif
+
 // Utility functions & structs.
 //----------------------------------------------------------------------------------
 
@@ -156,6 +184,90 @@ Color LinearFade(Color c1, Color c2, float fraction) {
     return c;
 }
 
+// EmitterRandom type.
+//----------------------------------------------------------------------------------
+
+// Number of interleaved streams of an EmitterRandom, one per SSE2 lane.
+#define EMITTER_RANDOM_LANES 4
+
+// EmitterRandom is a xoshiro128+ generator running EMITTER_RANDOM_LANES
+// interleaved streams, so that a batch of numbers is made a vector at a time.
+// Each Emitter owns one, which keeps emitters apart from the libc rand() state
+// and from each other's threads. The output is the same with or without SSE2.
+struct EmitterRandom {
+    uint32_t s[4][EMITTER_RANDOM_LANES];    // State word, then stream.
+};
+
+// EmitterRandom_Seed seeds all streams from one 64 bit seed, expanded by splitmix64.
+void EmitterRandom_Seed(EmitterRandom *r, unsigned long long seed) {
+    uint64_t x = seed;
+    for(int lane = 0; lane < EMITTER_RANDOM_LANES; lane++) {
+        for(int w = 0; w < 4; w += 2) {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            r->s[w][lane] = (uint32_t)z;
+            r->s[w + 1][lane] = (uint32_t)(z >> 32);
+        }
+    }
+}
+
+// EmitterRandom_Fill writes count uniform floats in [0, 1) to out, made from
+// the top 24 bits of each output. The streams always advance a whole step, so
+// numbers left over from an odd count are dropped.
+void EmitterRandom_Fill(EmitterRandom *r, float *out, unsigned long count) {
+#if defined(__SSE2__)
+    __m128i s0 = _mm_loadu_si128((__m128i *)r->s[0]);
+    __m128i s1 = _mm_loadu_si128((__m128i *)r->s[1]);
+    __m128i s2 = _mm_loadu_si128((__m128i *)r->s[2]);
+    __m128i s3 = _mm_loadu_si128((__m128i *)r->s[3]);
+    __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+
+    for(unsigned long i = 0; i < count; i += EMITTER_RANDOM_LANES) {
+        __m128i result = _mm_add_epi32(s0, s3);
+        __m128i t = _mm_slli_epi32(s1, 9);
+        s2 = _mm_xor_si128(s2, s0);
+        s3 = _mm_xor_si128(s3, s1);
+        s1 = _mm_xor_si128(s1, s2);
+        s0 = _mm_xor_si128(s0, s3);
+        s2 = _mm_xor_si128(s2, t);
+        s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+        __m128 u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale);
+        if(count - i >= EMITTER_RANDOM_LANES) {
+            _mm_storeu_ps(out + i, u);
+        } else {
+            float rest[EMITTER_RANDOM_LANES];
+            _mm_storeu_ps(rest, u);
+            memcpy(out + i, rest, (count - i) * sizeof(float));
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)r->s[0], s0);
+    _mm_storeu_si128((__m128i *)r->s[1], s1);
+    _mm_storeu_si128((__m128i *)r->s[2], s2);
+    _mm_storeu_si128((__m128i *)r->s[3], s3);
+#else
+    for(unsigned long i = 0; i < count; i += EMITTER_RANDOM_LANES) {
+        for(int lane = 0; lane < EMITTER_RANDOM_LANES; lane++) {
+            uint32_t result = r->s[0][lane] + r->s[3][lane];
+            uint32_t t = r->s[1][lane] << 9;
+            r->s[2][lane] ^= r->s[0][lane];
+            r->s[3][lane] ^= r->s[1][lane];
+            r->s[1][lane] ^= r->s[2][lane];
+            r->s[0][lane] ^= r->s[3][lane];
+            r->s[2][lane] ^= t;
+            r->s[3][lane] = (r->s[3][lane] << 11) | (r->s[3][lane] >> 21);
+            if(i + lane < count) {
+                out[i + lane] = (float)(result >> 8) * (1.0f / 16777216.0f);
+            }
+        }
+    }
+#endif
+}
+
 // Min/Max pair structs for various types.
 typedef struct FloatRange {
     float min;
@@ -167,6 +279,23 @@ typedef struct IntRange {
     int max;
 } IntRange;
 
+// Most stops of an EmitterConfig gradient or curve.
+#define EMITTER_RAMP_STOPS 8
+// Entries of the color and size tables baked from them, over a particle's life.
+#define EMITTER_RAMP_SIZE 256
+
+// Stops of gradients and curves over a particle's life, at 0 when it spawns and
+// 1 when it dies.
+typedef struct ColorStop {
+    float at;
+    Color color;
+} ColorStop;
+
+typedef struct FloatStop {
+    float at;
+    float value;
+} FloatStop;
+
 
 // EmitterConfig type.
 //----------------------------------------------------------------------------------
@@ -185,9 +314,16 @@ struct EmitterConfig {
     Vector2 externalAcceleration;   // External constant acceleration. e.g. gravity.
     Color startColor;               // The color the particle starts with when it spawns.
     Color endColor;                 // The color the particle ends with when it disappears.
+    ColorStop colorStops[EMITTER_RAMP_STOPS];   // Color over life, in order of at. Replaces startColor
+    int colorStopCount;                         // and endColor when colorStopCount is not 0.
+    FloatStop alphaStops[EMITTER_RAMP_STOPS];   // Alpha over life from 0 to 1, in order of at. Replaces
+    int alphaStopCount;                         // the alpha of the colors when alphaStopCount is not 0.
+    FloatStop sizeStops[EMITTER_RAMP_STOPS];    // Scale of the texture over life, in order of at.
+    int sizeStopCount;                          // The texture keeps its size when sizeStopCount is 0.
     FloatRange age;                 // Age range of particles in seconds.
     BlendMode blendMode;            // Color blending mode for all particles of this Emitter.
     Texture2D texture;              // The texture used as particle texture.    
+    unsigned int seed;              // Seed of the Emitter's random numbers, 0 picks one with GetRandomValue.
 
     bool (*particle_Deactivator)(struct Particle *); // Pointer to a function that determines when
                                                      // a particle is deactivated.
@@ -320,15 +456,516 @@ void Particle_Update(Particle *p, float dt) {
 // Emitter type.
 //----------------------------------------------------------------------------------
 
+// Number of float arrays holding the particle properties of an Emitter.
+#define EMITTER_FLOAT_ARRAYS 11
+
+// Particles drawn by one mesh of an EmitterBatch, the most whose vertices
+// 16 bit indices can address.
+#define EMITTER_BATCH_QUADS 16384
+
+// EmitterBatch holds the vertex buffers Emitter_Draw writes the particle quads to,
+// one mesh per EMITTER_BATCH_QUADS particles of capacity. They are made by the first
+// draw, which needs a graphics context.
+typedef struct EmitterBatch {
+    Mesh *meshes;
+    size_t length;              // Meshes made so far.
+    size_t capacity;
+    Material material;
+    bool loaded;
+} EmitterBatch;
+
 // Emitter is a single (point) source emitting many particles.
+// The particles are kept as a struct of arrays: every property has its own
+// contiguous array indexed by particle, all carved from a single allocation.
+// Live particles are packed into the first count slots, so the slots from count
+// on form the free stack; a particle that dies is replaced by the last live one.
 struct Emitter {
     EmitterConfig config;
     float mustEmit;            // Amount of particles to be emitted within next update call.
     Vector2 offset;             // Offset holds half the width and height of the texture.
     bool isEmitting;
-    Particle **particles;       // Array of all particles (by pointer).
+    size_t count;               // Number of live particles.
+    EmitterRandom random;       // Random numbers for new particles.
+    void *memory;               // The allocation all particle arrays point into.
+    float *originX;             // The origin of each particle (never changes).
+    float *originY;
+    float *positionX;           // Position of each particle in 2d space.
+    float *positionY;
+    float *velocityX;           // Velocity of each particle in 2d space.
+    float *velocityY;
+    float *externalAccelerationX;   // Acceleration of each particle in 2d space.
+    float *externalAccelerationY;
+    float *originAcceleration;  // Accelerates the velocity towards the origin.
+    float *age;                 // Age is measured in seconds.
+    float *ttl;                 // Ttl is the time to live in seconds.
+    unsigned char *active;      // Cleared by an update for particles that died, before they are removed.
+    EmitterBatch batch;
+    Color colorRamp[EMITTER_RAMP_SIZE];     // Color and size over life baked from the config,
+    float sizeRamp[EMITTER_RAMP_SIZE];      // looked up by Emitter_RampIndex.
 };
 
+// Emitter_Arrays lists the addresses of the float array pointers of e.
+static void Emitter_Arrays(Emitter *e, float **arrays[EMITTER_FLOAT_ARRAYS]) {
+    float **list[EMITTER_FLOAT_ARRAYS] = {
+        &e->originX, &e->originY, &e->positionX, &e->positionY, &e->velocityX, &e->velocityY,
+        &e->externalAccelerationX, &e->externalAccelerationY, &e->originAcceleration, &e->age, &e->ttl
+    };
+    memcpy(arrays, list, sizeof(list));
+}
+
+// Emitter_Allocate points the particle arrays of e into a new allocation with room for
+// capacity particles, keeping the live particles that fit.
+static bool Emitter_Allocate(Emitter *e, size_t capacity) {
+    // Every array starts on a 64 byte boundary of the allocation.
+    size_t stride = (capacity * sizeof(float) + 63) & ~(size_t)63;
+    char *memory = calloc(1, stride * EMITTER_FLOAT_ARRAYS + capacity + 1);
+    if(memory == NULL) {
+        return false;
+    }
+
+    float **arrays[EMITTER_FLOAT_ARRAYS];
+    Emitter_Arrays(e, arrays);
+    size_t keep = e->count < capacity ? e->count : capacity;
+
+    for(int a = 0; a < EMITTER_FLOAT_ARRAYS; a++) {
+        float *array = (float *)(memory + a * stride);
+        if(keep > 0) {
+            memcpy(array, *arrays[a], keep * sizeof(float));
+        }
+        *arrays[a] = array;
+    }
+    e->active = (unsigned char *)(memory + EMITTER_FLOAT_ARRAYS * stride);
+    memset(e->active, 1, keep);
+    e->count = keep;
+
+    free(e->memory);
+    e->memory = memory;
+
+    return true;
+}
+
+// Emitter_GetParticle copies particle i of e into p, for deactivator functions.
+static void Emitter_GetParticle(Emitter *e, size_t i, Particle *p) {
+    p->origin = (Vector2){.x = e->originX[i], .y = e->originY[i]};
+    p->position = (Vector2){.x = e->positionX[i], .y = e->positionY[i]};
+    p->velocity = (Vector2){.x = e->velocityX[i], .y = e->velocityY[i]};
+    p->externalAcceleration = (Vector2){.x = e->externalAccelerationX[i], .y = e->externalAccelerationY[i]};
+    p->originAcceleration = e->originAcceleration[i];
+    p->age = e->age[i];
+    p->ttl = e->ttl[i];
+    p->active = e->active[i];
+    p->particle_Deactivator = e->config.particle_Deactivator;
+}
+
+// Number of random floats used to init one particle.
+#define EMITTER_SPAWN_RANDOMS 6
+// Particles whose random numbers are made in one batch.
+#define EMITTER_SPAWN_BATCH 64
+
+// Emitter_RandomIn maps a uniform u in [0, 1) onto range.
+static inline float Emitter_RandomIn(FloatRange range, float u) {
+    return u * (range.max - range.min) + range.min;
+}
+
+// Emitter_Spawn inits up to n particles in the next free slots of e like Particle_Init
+// does, drawing their random numbers from the emitter in batches. Returns the number
+// of particles spawned, fewer than n when e is full.
+static size_t Emitter_Spawn(Emitter *e, size_t n) {
+    EmitterConfig *cfg = &e->config;
+    float randoms[EMITTER_SPAWN_BATCH * EMITTER_SPAWN_RANDOMS];
+
+    if(n > cfg->capacity - e->count) {
+        n = cfg->capacity - e->count;
+    }
+
+    for(size_t done = 0; done < n; ) {
+        size_t batch = n - done < EMITTER_SPAWN_BATCH ? n - done : EMITTER_SPAWN_BATCH;
+        EmitterRandom_Fill(&e->random, randoms, batch * EMITTER_SPAWN_RANDOMS);
+
+        for(size_t b = 0; b < batch; b++) {
+            const float *u = randoms + b * EMITTER_SPAWN_RANDOMS;
+            size_t i = e->count++;
+
+            e->age[i] = 0;
+            e->originX[i] = cfg->origin.x;
+            e->originY[i] = cfg->origin.y;
+
+            // Rotate base direction with a random angle.
+            Vector2 res = RotateV2(cfg->direction, Emitter_RandomIn(cfg->directionAngle, u[0]));
+
+            // Scale it to a random velocity (direction is normalized) and rotate that
+            // by another random angle.
+            float randv = Emitter_RandomIn(cfg->velocity, u[1]);
+            Vector2 velocity = RotateV2((Vector2){.x = res.x * randv, .y = res.y * randv},
+                                        Emitter_RandomIn(cfg->velocityAngle, u[2]));
+            e->velocityX[i] = velocity.x;
+            e->velocityY[i] = velocity.y;
+
+            // Get a random value for origin offset and apply it to position.
+            float rando = Emitter_RandomIn(cfg->offset, u[3]);
+            e->positionX[i] = cfg->origin.x + res.x * rando;
+            e->positionY[i] = cfg->origin.y + res.y * rando;
+
+            // Get a random value for the intrinsic particle acceleration
+            e->originAcceleration[i] = Emitter_RandomIn(cfg->originAcceleration, u[4]);
+            e->externalAccelerationX[i] = cfg->externalAcceleration.x;
+            e->externalAccelerationY[i] = cfg->externalAcceleration.y;
+            e->ttl[i] = Emitter_RandomIn(cfg->age, u[5]);
+            e->active[i] = 1;
+        }
+        done += batch;
+    }
+
+    return n;
+}
+
+// Emitter_Compact swap-removes the particles whose active flag an update cleared,
+// moving the last live particle into each hole.
+static void Emitter_Compact(Emitter *e) {
+    float **arrays[EMITTER_FLOAT_ARRAYS];
+    Emitter_Arrays(e, arrays);
+
+    size_t i = 0;
+    while(i < e->count) {
+        if(e->active[i]) {
+            i++;
+            continue;
+        }
+
+        // The moved particle is checked again in the next round.
+        size_t last = --e->count;
+        if(i != last) {
+            for(int a = 0; a < EMITTER_FLOAT_ARRAYS; a++) {
+                (*arrays[a])[i] = (*arrays[a])[last];
+            }
+            e->active[i] = e->active[last];
+        }
+        e->active[last] = 0;
+    }
+}
+
+// Emitter_UpdateParticle updates particle i of e like Particle_Update does,
+// clearing its active flag if it dies.
+// ageOnly tells that the deactivator is the default one, which is then inlined;
+// any other deactivator gets a copy of the particle.
+static inline void Emitter_UpdateParticle(Emitter *e, size_t i, float dt, bool ageOnly) {
+    float age = e->age[i] + dt;
+    e->age[i] = age;
+
+    bool deactivate;
+    if(ageOnly) {
+        deactivate = age > e->ttl[i];
+    } else {
+        Particle p;
+        Emitter_GetParticle(e, i, &p);
+        deactivate = e->config.particle_Deactivator(&p);
+    }
+    if(deactivate) {
+        e->active[i] = 0;
+        return;
+    }
+
+    float x = e->positionX[i];
+    float y = e->positionY[i];
+    float vx = e->velocityX[i];
+    float vy = e->velocityY[i];
+
+    // Same as NormalizeV2, with a float square root.
+    float dx = e->originX[i] - x;
+    float dy = e->originY[i] - y;
+    if(dx != 0 || dy != 0) {
+        float len = sqrtf(dx*dx + dy*dy);
+        dx /= len;
+        dy /= len;
+    }
+
+    // Update velocity by internal acceleration.
+    vx += dx * e->originAcceleration[i] * dt;
+    vy += dy * e->originAcceleration[i] * dt;
+
+    // Update velocity by external acceleration.
+    vx += e->externalAccelerationX[i]*dt;
+    vy += e->externalAccelerationY[i]*dt;
+
+    // Update position by velocity.
+    e->velocityX[i] = vx;
+    e->velocityY[i] = vy;
+    e->positionX[i] = x + vx * dt;
+    e->positionY[i] = y + vy * dt;
+}
+
+#if defined(__SSE2__)
+// Emitter_ActiveBytes turns two lane masks into the active flags of 8 particles,
+// the low 8 bytes of the result.
+static inline __m128i Emitter_ActiveBytes(__m128 low, __m128 high) {
+    __m128i one = _mm_set1_epi32(1);
+    __m128i words = _mm_packs_epi32(_mm_and_si128(_mm_castps_si128(low), one), _mm_and_si128(_mm_castps_si128(high), one));
+    return _mm_packus_epi16(words, words);
+}
+#endif
+
+#if defined(__AVX__)
+// Emitter_IntegrateLanes advances the live particles i to i+7 like
+// Emitter_UpdateParticle, with an age only deactivator. The origin direction uses
+// a reciprocal square root refined by one Newton-Raphson step. Particles that die
+// are advanced too, they are removed afterwards.
+static inline void Emitter_IntegrateLanes(Emitter *e, size_t i, float dt) {
+    __m256 vdt = _mm256_set1_ps(dt);
+
+    __m256 age = _mm256_add_ps(_mm256_loadu_ps(e->age + i), vdt);
+    __m256 keep = _mm256_cmp_ps(age, _mm256_loadu_ps(e->ttl + i), _CMP_LE_OQ);
+    _mm256_storeu_ps(e->age + i, age);
+
+    __m256 x = _mm256_loadu_ps(e->positionX + i);
+    __m256 y = _mm256_loadu_ps(e->positionY + i);
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(e->originX + i), x);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(e->originY + i), y);
+    __m256 len2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 r = _mm256_rsqrt_ps(len2);
+    r = _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f),
+        _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), len2), _mm256_mul_ps(r, r))));
+    // A particle sitting on its origin has no direction.
+    r = _mm256_and_ps(r, _mm256_cmp_ps(len2, _mm256_setzero_ps(), _CMP_GT_OQ));
+    dx = _mm256_mul_ps(dx, r);
+    dy = _mm256_mul_ps(dy, r);
+
+    __m256 oa = _mm256_loadu_ps(e->originAcceleration + i);
+    __m256 vx = _mm256_add_ps(_mm256_loadu_ps(e->velocityX + i), _mm256_mul_ps(_mm256_mul_ps(dx, oa), vdt));
+    __m256 vy = _mm256_add_ps(_mm256_loadu_ps(e->velocityY + i), _mm256_mul_ps(_mm256_mul_ps(dy, oa), vdt));
+    vx = _mm256_add_ps(vx, _mm256_mul_ps(_mm256_loadu_ps(e->externalAccelerationX + i), vdt));
+    vy = _mm256_add_ps(vy, _mm256_mul_ps(_mm256_loadu_ps(e->externalAccelerationY + i), vdt));
+
+    _mm256_storeu_ps(e->velocityX + i, vx);
+    _mm256_storeu_ps(e->velocityY + i, vy);
+    _mm256_storeu_ps(e->positionX + i, _mm256_add_ps(x, _mm256_mul_ps(vx, vdt)));
+    _mm256_storeu_ps(e->positionY + i, _mm256_add_ps(y, _mm256_mul_ps(vy, vdt)));
+
+    _mm_storel_epi64((__m128i *)(e->active + i),
+        Emitter_ActiveBytes(_mm256_castps256_ps128(keep), _mm256_extractf128_ps(keep, 1)));
+}
+#elif defined(__SSE2__)
+// Emitter_IntegrateLanes advances the live particles i to i+3 like
+// Emitter_UpdateParticle, with an age only deactivator. The origin direction uses
+// a reciprocal square root refined by one Newton-Raphson step. Particles that die
+// are advanced too, they are removed afterwards.
+static inline void Emitter_IntegrateLanes(Emitter *e, size_t i, float dt) {
+    __m128 vdt = _mm_set1_ps(dt);
+
+    __m128 age = _mm_add_ps(_mm_loadu_ps(e->age + i), vdt);
+    __m128 keep = _mm_cmple_ps(age, _mm_loadu_ps(e->ttl + i));
+    _mm_storeu_ps(e->age + i, age);
+
+    __m128 x = _mm_loadu_ps(e->positionX + i);
+    __m128 y = _mm_loadu_ps(e->positionY + i);
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(e->originX + i), x);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(e->originY + i), y);
+    __m128 len2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    __m128 r = _mm_rsqrt_ps(len2);
+    r = _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), len2), _mm_mul_ps(r, r))));
+    // A particle sitting on its origin has no direction.
+    r = _mm_and_ps(r, _mm_cmpgt_ps(len2, _mm_setzero_ps()));
+    dx = _mm_mul_ps(dx, r);
+    dy = _mm_mul_ps(dy, r);
+
+    __m128 oa = _mm_loadu_ps(e->originAcceleration + i);
+    __m128 vx = _mm_add_ps(_mm_loadu_ps(e->velocityX + i), _mm_mul_ps(_mm_mul_ps(dx, oa), vdt));
+    __m128 vy = _mm_add_ps(_mm_loadu_ps(e->velocityY + i), _mm_mul_ps(_mm_mul_ps(dy, oa), vdt));
+    vx = _mm_add_ps(vx, _mm_mul_ps(_mm_loadu_ps(e->externalAccelerationX + i), vdt));
+    vy = _mm_add_ps(vy, _mm_mul_ps(_mm_loadu_ps(e->externalAccelerationY + i), vdt));
+
+    _mm_storeu_ps(e->velocityX + i, vx);
+    _mm_storeu_ps(e->velocityY + i, vy);
+    _mm_storeu_ps(e->positionX + i, _mm_add_ps(x, _mm_mul_ps(vx, vdt)));
+    _mm_storeu_ps(e->positionY + i, _mm_add_ps(y, _mm_mul_ps(vy, vdt)));
+
+    int flags = _mm_cvtsi128_si32(Emitter_ActiveBytes(keep, keep));
+    memcpy(e->active + i, &flags, 4);
+}
+#endif
+
+// Emitter_RampValue evaluates a curve of count stops at fraction, linearly between
+// stops and flat before the first and after the last one.
+static float Emitter_RampValue(const FloatStop *stops, int count, float fraction) {
+    if(fraction <= stops[0].at) {
+        return stops[0].value;
+    }
+    for(int s = 1; s < count; s++) {
+        if(fraction < stops[s].at) {
+            float t = (fraction - stops[s-1].at) / (stops[s].at - stops[s-1].at);
+            return stops[s-1].value + (stops[s].value - stops[s-1].value) * t;
+        }
+    }
+    return stops[count-1].value;
+}
+
+// Emitter_RampColor is the color of a particle of cfg at fraction of its life.
+// Without stops it is the LinearFade from startColor to endColor.
+static Color Emitter_RampColor(const EmitterConfig *cfg, float fraction) {
+    Color c;
+    if(cfg->colorStopCount == 0) {
+        c = LinearFade(cfg->startColor, cfg->endColor, fraction);
+    } else {
+        const ColorStop *stops = cfg->colorStops;
+        int n = cfg->colorStopCount;
+        int s = 0;
+        while(s < n && fraction >= stops[s].at) {
+            s++;
+        }
+        if(s == 0) {
+            c = stops[0].color;
+        } else if(s == n) {
+            c = stops[n-1].color;
+        } else {
+            float t = (fraction - stops[s-1].at) / (stops[s].at - stops[s-1].at);
+            Color a = stops[s-1].color;
+            Color b = stops[s].color;
+            c.r = (unsigned char)((float)a.r + ((float)b.r - (float)a.r) * t + 0.5f);
+            c.g = (unsigned char)((float)a.g + ((float)b.g - (float)a.g) * t + 0.5f);
+            c.b = (unsigned char)((float)a.b + ((float)b.b - (float)a.b) * t + 0.5f);
+            c.a = (unsigned char)((float)a.a + ((float)b.a - (float)a.a) * t + 0.5f);
+        }
+    }
+
+    if(cfg->alphaStopCount > 0) {
+        float alpha = Emitter_RampValue(cfg->alphaStops, cfg->alphaStopCount, fraction);
+        alpha = alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha);
+        c.a = (unsigned char)(alpha * 255.0f + 0.5f);
+    }
+    return c;
+}
+
+// Emitter_RampSize is the texture scale of a particle of cfg at fraction of its life.
+static float Emitter_RampSize(const EmitterConfig *cfg, float fraction) {
+    if(cfg->sizeStopCount == 0) {
+        return 1.0f;
+    }
+    return Emitter_RampValue(cfg->sizeStops, cfg->sizeStopCount, fraction);
+}
+
+// Emitter_BakeRamps fills the color and size tables of e from its config.
+static void Emitter_BakeRamps(Emitter *e) {
+    for(int k = 0; k < EMITTER_RAMP_SIZE; k++) {
+        float fraction = (float)k / (EMITTER_RAMP_SIZE - 1);
+        e->colorRamp[k] = Emitter_RampColor(&e->config, fraction);
+        e->sizeRamp[k] = Emitter_RampSize(&e->config, fraction);
+    }
+}
+
+// Emitter_RampIndex is the entry of the ramps nearest to how far through its life
+// particle i of e is.
+static inline int Emitter_RampIndex(const Emitter *e, size_t i) {
+    int k = (int)(e->age[i] / e->ttl[i] * (EMITTER_RAMP_SIZE - 1) + 0.5f);
+    return k < 0 ? 0 : (k > EMITTER_RAMP_SIZE - 1 ? EMITTER_RAMP_SIZE - 1 : k);
+}
+
+// Emitter_BuildQuads writes the quads of the count particles from first on: four
+// vertices of x, y and z going top left, bottom left, bottom right and top right, and
+// their colors. Quads are scaled around the particle and start at whole pixels like
+// DrawTexture puts them.
+static void Emitter_BuildQuads(const Emitter *e, size_t first, size_t count, float *vertices, unsigned char *colors) {
+    for(size_t q = 0; q < count; q++) {
+        size_t i = first + q;
+        int k = Emitter_RampIndex(e, i);
+        float scale = e->sizeRamp[k];
+        float w = (float)e->config.texture.width * scale;
+        float h = (float)e->config.texture.height * scale;
+        float x = (float)(int)(e->positionX[i] - e->offset.x * scale);
+        float y = (float)(int)(e->positionY[i] - e->offset.y * scale);
+
+        float *v = vertices + q*12;
+        v[0] = x;       v[1] = y;       v[2] = 0;
+        v[3] = x;       v[4] = y + h;   v[5] = 0;
+        v[6] = x + w;   v[7] = y + h;   v[8] = 0;
+        v[9] = x + w;   v[10] = y;      v[11] = 0;
+
+        Color c = e->colorRamp[k];
+        for(int corner = 0; corner < 4; corner++) {
+            memcpy(colors + q*16 + corner*4, &c, 4);
+        }
+    }
+}
+
+// Emitter_LoadMesh makes a mesh for quads particles, with the texture coordinates and
+// indices that never change, and uploads it for updates every frame.
+static bool Emitter_LoadMesh(Mesh *mesh, size_t quads) {
+    *mesh = (Mesh){0};
+    mesh->vertexCount = (int)quads*4;
+    mesh->triangleCount = (int)quads*2;
+    mesh->vertices = MemAlloc(mesh->vertexCount*3*sizeof(float));
+    mesh->texcoords = MemAlloc(mesh->vertexCount*2*sizeof(float));
+    mesh->colors = MemAlloc(mesh->vertexCount*4);
+    mesh->indices = MemAlloc(mesh->triangleCount*3*sizeof(unsigned short));
+    if(mesh->vertices == NULL || mesh->texcoords == NULL || mesh->colors == NULL || mesh->indices == NULL) {
+        MemFree(mesh->vertices);
+        MemFree(mesh->texcoords);
+        MemFree(mesh->colors);
+        MemFree(mesh->indices);
+        return false;
+    }
+
+    const float uv[8] = {0, 0, 0, 1, 1, 1, 1, 0};
+    for(size_t q = 0; q < quads; q++) {
+        memcpy(mesh->texcoords + q*8, uv, sizeof(uv));
+
+        // Two triangles in the same winding as the quads of DrawTexture.
+        unsigned short corner = (unsigned short)(q*4);
+        unsigned short *index = mesh->indices + q*6;
+        index[0] = corner;
+        index[1] = corner + 1;
+        index[2] = corner + 2;
+        index[3] = corner;
+        index[4] = corner + 2;
+        index[5] = corner + 3;
+    }
+
+    UploadMesh(mesh, true);
+    return true;
+}
+
+// Emitter_LoadBatch makes the meshes for the live particles of e that have none yet.
+static bool Emitter_LoadBatch(Emitter *e) {
+    EmitterBatch *b = &e->batch;
+    if(!b->loaded) {
+        b->capacity = (e->config.capacity + EMITTER_BATCH_QUADS - 1) / EMITTER_BATCH_QUADS;
+        b->meshes = calloc(b->capacity, sizeof(Mesh));
+        if(b->meshes == NULL) {
+            return false;
+        }
+        b->length = 0;
+        b->material = LoadMaterialDefault();
+        b->loaded = true;
+    }
+
+    size_t needed = (e->count + EMITTER_BATCH_QUADS - 1) / EMITTER_BATCH_QUADS;
+    for(; b->length < needed; b->length++) {
+        size_t quads = e->config.capacity - b->length*EMITTER_BATCH_QUADS;
+        if(quads > EMITTER_BATCH_QUADS) {
+            quads = EMITTER_BATCH_QUADS;
+        }
+        if(!Emitter_LoadMesh(&b->meshes[b->length], quads)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Emitter_UnloadBatch frees the meshes of e, if it was ever drawn.
+static void Emitter_UnloadBatch(Emitter *e) {
+    EmitterBatch *b = &e->batch;
+    if(!b->loaded) {
+        return;
+    }
+
+    for(size_t m = 0; m < b->length; m++) {
+        UnloadMesh(b->meshes[m]);
+    }
+    free(b->meshes);
+    // UnloadMaterial would unload the particle texture too.
+    MemFree(b->material.maps);
+    *b = (EmitterBatch){0};
+}
+
 // Emitter_New creates a new Emitter object.
 Emitter * Emitter_New(EmitterConfig cfg) {
     Emitter *e = calloc(1, sizeof(Emitter));
@@ -338,57 +975,41 @@ Emitter * Emitter_New(EmitterConfig cfg) {
     e->config = cfg;
     e->offset.x = e->config.texture.width/2;
     e->offset.y = e->config.texture.height/2;
-    e->particles = calloc(e->config.capacity, sizeof(Particle *));
-    if(e->particles == NULL) {
+    if(!Emitter_Allocate(e, e->config.capacity)) {
         free(e);
         return NULL;
     }
     e->mustEmit = 0;
+    unsigned long long seed = cfg.seed;
+    if(seed == 0) {
+        seed = (unsigned long long)GetRandomValue(0, RAND_MAX) << 32 | (unsigned long long)GetRandomValue(0, RAND_MAX);
+    }
+    EmitterRandom_Seed(&e->random, seed);
     // Normalize direction for future uses.
     e->config.direction = NormalizeV2(e->config.direction);
-
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        e->particles[i] = Particle_New(e->config.particle_Deactivator);
-    }
+    Emitter_BakeRamps(e);
 
     return e;
 }
 
 // Emitter_Reinit reinits the given Emitter with a new EmitterConfig.
 bool Emitter_Reinit(Emitter *e, EmitterConfig cfg) {
-    if(cfg.capacity > e->config.capacity) {
-        // Array needs to be grown to the new size.
-        Particle **newParticles = realloc(e->particles, cfg.capacity * sizeof(Particle *));
-        if(newParticles == NULL) {
-            return false;
-        }
-        e->particles = newParticles;
-
-        // Create new Particles
-        for(size_t i = e->config.capacity; i < cfg.capacity; i++) {
-            e->particles[i] = Particle_New(cfg.particle_Deactivator);
-        }
-    } else if(cfg.capacity < e->config.capacity) {
-        // First we free the now obsolete Particles.
-        for(size_t i = cfg.capacity; i < e->config.capacity; i++) {
-            Particle_Free(e->particles[i]);
-        }
-
-        // Array needs to be shrunk to the new size.
-        Particle **newParticles = realloc(e->particles, cfg.capacity * sizeof(Particle *));
-        if(newParticles == NULL) {
+    // Grown or shrunk arrays keep the live particles that still fit.
+    // The meshes are remade for the new capacity by the next draw.
+    if(cfg.capacity != e->config.capacity) {
+        if(!Emitter_Allocate(e, cfg.capacity)) {
             return false;
         }
-        e->particles = newParticles;
+        Emitter_UnloadBatch(e);
     }
 
-    // Set new config.
-    e->config = cfg;
-
-    // Set new Particle deactivator function for all Particles.
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        e->particles[i]->particle_Deactivator = e->config.particle_Deactivator;
+    // Set new config, the deactivator function applies to all particles.
+    // A new nonzero seed restarts the random numbers.
+    if(cfg.seed != 0 && cfg.seed != e->config.seed) {
+        EmitterRandom_Seed(&e->random, cfg.seed);
     }
+    e->config = cfg;
+    Emitter_BakeRamps(e);
 
     return true;
 }
@@ -405,10 +1026,8 @@ void Emitter_Stop(Emitter *e) {
 
 // Emitter_Free frees all allocated resources.
 void Emitter_Free(Emitter *e) {
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        Particle_Free(e->particles[i]);
-    }
-    free(e->particles);
+    Emitter_UnloadBatch(e);
+    free(e->memory);
     free(e);
 }
 
@@ -416,65 +1035,123 @@ void Emitter_Free(Emitter *e) {
 // ignoring the state of e->isEmitting. Use this for singular events
 // instead of continuous output.
 void Emitter_Burst(Emitter *e) {
-    Particle *p = NULL;
-    size_t emitted = 0;
+    IntRange burst = e->config.burst;
+    float u;
+    EmitterRandom_Fill(&e->random, &u, 1);
+    int amount = burst.min + (int)(u * (float)(burst.max - burst.min + 1));
+    if(amount <= 0) {
+        return;
+    }
 
-    int amount = GetRandomValue(e->config.burst.min, e->config.burst.max);
+    size_t first = e->count;
+    Emitter_Spawn(e, (size_t)amount);
+    for(size_t i = first; i < e->count; i++) {
+        e->positionX[i] = e->config.origin.x;
+        e->positionY[i] = e->config.origin.y;
+    }
+}
 
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        p = e->particles[i];
-        if(!p->active) {
-            Particle_Init(p, &e->config);
-            p->position = e->config.origin;
-            emitted++;
-        }
-        if(emitted >= amount) {
-            return;
+// Emitter_Emit spawns the particles due for emission within the next dt seconds.
+static void Emitter_Emit(Emitter *e, float dt) {
+    if(!e->isEmitting) {
+        return;
+    }
+
+    e->mustEmit += dt * (float)e->config.emissionRate;
+    size_t emitNow = (size_t)e->mustEmit; // floor
+    e->mustEmit -= (float)Emitter_Spawn(e, emitNow);
+}
+
+// Emitter_Integrate advances the live particles begin to end-1 of e, EMITTER_LANES at a
+// time when the deactivator allows it. Particles that die get their active flag cleared
+// and are left for Emitter_Compact. Ranges that start at a multiple of EMITTER_LANES give
+// the same results as one call over all of them.
+static void Emitter_Integrate(Emitter *e, size_t begin, size_t end, float dt) {
+    bool ageOnly = e->config.particle_Deactivator == NULL || e->config.particle_Deactivator == Particle_DeactivatorAge;
+    size_t i = begin;
+#if EMITTER_LANES > 1
+    if(ageOnly) {
+        for(; i + EMITTER_LANES <= end; i += EMITTER_LANES) {
+            Emitter_IntegrateLanes(e, i, dt);
         }
     }
+#endif
+    for(; i < end; i++) {
+        Emitter_UpdateParticle(e, i, dt, ageOnly);
+    }
+}
+
+// Emitter_UpdateReference is the particle by particle Emitter_Update,
+// the reference the vectorized integrator is tested against.
+unsigned long Emitter_UpdateReference(Emitter *e, float dt) {
+    Emitter_Emit(e, dt);
+
+    bool ageOnly = e->config.particle_Deactivator == NULL || e->config.particle_Deactivator == Particle_DeactivatorAge;
+    unsigned long counter = e->count;
+    for(size_t i = 0; i < counter; i++) {
+        Emitter_UpdateParticle(e, i, dt, ageOnly);
+    }
+    Emitter_Compact(e);
+
+    return counter;
 }
 
 // Emitter_Update updates all particles and returns
 // the current amount of active particles.
+// Due particles are emitted into free slots first, then the live ones are
+// advanced EMITTER_LANES at a time and the dead ones removed. The cost follows
+// the number of live particles, not the capacity.
 unsigned long Emitter_Update(Emitter *e, float dt) {
-    size_t emitNow = 0;
-    Particle *p = NULL;
-    unsigned long counter = 0;
-
-    if(e->isEmitting) {
-        e->mustEmit += dt * (float)e->config.emissionRate;
-        emitNow = (size_t)e->mustEmit; // floor
-    }
-
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        p = e->particles[i];
-        if(p->active) {
-            Particle_Update(p, dt);
-            counter++;
-        } else if(e->isEmitting && emitNow > 0) {
-            // emit new particles here
-            Particle_Init(p, &e->config);
-            Particle_Update(p, dt);
-            emitNow--;
-            e->mustEmit--;
-            counter++;
-        }
-    }
+    Emitter_Emit(e, dt);
+
+    unsigned long counter = e->count;
+    Emitter_Integrate(e, 0, counter, dt);
+    Emitter_Compact(e);
 
     return counter;
 }
 
 // Emitter_Draw draws all active particles.
+// Their quads are written to the meshes of e in one pass and drawn with one
+// DrawMesh per EMITTER_BATCH_QUADS particles.
 void Emitter_Draw(Emitter *e) {
+    if(e->count == 0) {
+        return;
+    }
+
     BeginBlendMode(e->config.blendMode);
-    for(size_t i = 0; i < e->config.capacity; i++) {
-        Particle *p = e->particles[i];
-        if(p->active) {
-            DrawTexture(e->config.texture,
-                        e->particles[i]->position.x - e->offset.x,
-                        e->particles[i]->position.y - e->offset.y,
-                        LinearFade(e->config.startColor, e->config.endColor,p->age/p->ttl));
+    if(!Emitter_LoadBatch(e)) {
+        // Draw them one by one then.
+        for(size_t i = 0; i < e->count; i++) {
+            int k = Emitter_RampIndex(e, i);
+            float scale = e->sizeRamp[k];
+            Vector2 position = {
+                .x = (float)(int)(e->positionX[i] - e->offset.x * scale),
+                .y = (float)(int)(e->positionY[i] - e->offset.y * scale)
+            };
+            DrawTextureEx(e->config.texture, position, 0, scale, e->colorRamp[k]);
         }
+        EndBlendMode();
+        return;
+    }
+
+    // DrawMesh draws right away, what was batched before has to go first.
+    rlDrawRenderBatchActive();
+
+    Matrix identity = {.m0 = 1, .m5 = 1, .m10 = 1, .m15 = 1};
+    e->batch.material.maps[MATERIAL_MAP_DIFFUSE].texture = e->config.texture;
+    for(size_t m = 0; m * EMITTER_BATCH_QUADS < e->count; m++) {
+        Mesh *mesh = &e->batch.meshes[m];
+        size_t first = m * EMITTER_BATCH_QUADS;
+        size_t quads = e->count - first < EMITTER_BATCH_QUADS ? e->count - first : EMITTER_BATCH_QUADS;
+
+        Emitter_BuildQuads(e, first, quads, mesh->vertices, mesh->colors);
+        UpdateMeshBuffer(*mesh, 0, mesh->vertices, (int)(quads*12*sizeof(float)), 0);
+        UpdateMeshBuffer(*mesh, 3, mesh->colors, (int)(quads*16), 0);
+
+        Mesh part = *mesh;
+        part.triangleCount = (int)quads*2;
+        DrawMesh(part, e->batch.material, identity);
     }
     EndBlendMode();
 }
@@ -483,6 +1160,17 @@ void Emitter_Draw(Emitter *e) {
 // ParticleSystem type.
 //----------------------------------------------------------------------------------
 
+// Live particles of an emitter updated by one job of a parallel ParticleSystem_Update,
+// a multiple of EMITTER_LANES.
+#define PARTICLESYSTEM_CHUNK 16384
+
+// ParticleSystem_Chunk is a range of particles of one emitter updated by one job.
+typedef struct ParticleSystem_Chunk {
+    Emitter *emitter;
+    size_t begin;
+    size_t end;
+} ParticleSystem_Chunk;
+
 // ParticleSystem is a set of emitters grouped logically
 // together to achieve a specific visual effect.
 // While Emitters can be used independently, ParticleSystem
@@ -493,6 +1181,13 @@ struct ParticleSystem {
     size_t capacity;
     Vector2 origin;
     Emitter **emitters;
+
+    // Set by ParticleSystem_SetRunner to update in parallel.
+    ParticleSystem_Runner run;
+    void *runner;
+    ParticleSystem_Chunk *chunks;
+    size_t chunkCapacity;
+    float dt;
 };
 
 // Particlesystem_New creates a new particle system
@@ -594,18 +1289,84 @@ void ParticleSystem_Draw(ParticleSystem *ps) {
     }
 }
 
+// ParticleSystem_SetRunner makes ParticleSystem_Update hand its work to run, passing it
+// runner. A NULL run updates the emitters one after another on the calling thread.
+void ParticleSystem_SetRunner(ParticleSystem *ps, ParticleSystem_Runner run, void *runner) {
+    ps->run = run;
+    ps->runner = runner;
+}
+
+// ParticleSystem_IntegrateJob advances the particles of one chunk.
+static void ParticleSystem_IntegrateJob(void *user, int job) {
+    ParticleSystem *ps = user;
+    ParticleSystem_Chunk *chunk = &ps->chunks[job];
+    Emitter_Integrate(chunk->emitter, chunk->begin, chunk->end, ps->dt);
+}
+
+// ParticleSystem_CompactJob removes the dead particles of one emitter.
+static void ParticleSystem_CompactJob(void *user, int job) {
+    ParticleSystem *ps = user;
+    Emitter_Compact(ps->emitters[job]);
+}
+
 // ParticleSystem_Update runs Emitter_Update on all registered Emitters.
+// With a runner the emitters emit on the calling thread, each with its own random
+// numbers, then every chunk of live particles is advanced as a job and every emitter
+// compacted as a job. Jobs never share particles and chunks start at multiples of
+// EMITTER_LANES, so the particles come out exactly as from Emitter_Update whatever
+// thread ran which job. The counts are summed here after the jobs returned, so the
+// jobs share no counter.
 unsigned long ParticleSystem_Update(ParticleSystem *ps, float dt) {
     size_t counter = 0;
+    if(ps->run == NULL) {
+        for(size_t i = 0; i < ps->length; i++) {
+            counter += Emitter_Update(ps->emitters[i], dt);
+        }
+        return counter;
+    }
+
+    size_t chunks = 0;
     for(size_t i = 0; i < ps->length; i++) {
-        counter += Emitter_Update(ps->emitters[i], dt);
+        Emitter *e = ps->emitters[i];
+        Emitter_Emit(e, dt);
+        counter += e->count;
+        chunks += (e->count + PARTICLESYSTEM_CHUNK - 1) / PARTICLESYSTEM_CHUNK;
+    }
+
+    if(chunks > ps->chunkCapacity) {
+        ParticleSystem_Chunk *newChunks = realloc(ps->chunks, chunks * sizeof(ParticleSystem_Chunk));
+        if(newChunks == NULL) {
+            // Fall back to updating on this thread, the emission already happened.
+            for(size_t i = 0; i < ps->length; i++) {
+                Emitter_Integrate(ps->emitters[i], 0, ps->emitters[i]->count, dt);
+                Emitter_Compact(ps->emitters[i]);
+            }
+            return counter;
+        }
+        ps->chunks = newChunks;
+        ps->chunkCapacity = chunks;
     }
+
+    size_t c = 0;
+    for(size_t i = 0; i < ps->length; i++) {
+        Emitter *e = ps->emitters[i];
+        for(size_t begin = 0; begin < e->count; begin += PARTICLESYSTEM_CHUNK) {
+            size_t end = begin + PARTICLESYSTEM_CHUNK < e->count ? begin + PARTICLESYSTEM_CHUNK : e->count;
+            ps->chunks[c++] = (ParticleSystem_Chunk){.emitter = e, .begin = begin, .end = end};
+        }
+    }
+
+    ps->dt = dt;
+    ps->run(ps->runner, ParticleSystem_IntegrateJob, ps, (int)chunks);
+    ps->run(ps->runner, ParticleSystem_CompactJob, ps, (int)ps->length);
+
     return counter;
 }
 
 // ParticleSystem_Free only frees its own resources.
 // The emitters referenced here must be freed on their own.
 void ParticleSystem_Free(ParticleSystem *p) {
+    free(p->chunks);
     free(p->emitters);
     free(p);
 }
@@ -0,0 +1,195 @@
+#include "jobs.h"
+
+#include <stdio.h>
+
+static inline uint64_t job_range(uint32_t next, uint32_t end)
+{
+    return (uint64_t)end << 32 | next;
+}
+
+// take_job claims the next job of queue q, -1 once it is empty
+static int take_job(JobQueue *q)
+{
+    uint64_t range = atomic_load_explicit(&q->range, memory_order_acquire);
+    for (;;)
+    {
+        uint32_t next = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (next >= end)
+            return -1;
+        if (atomic_compare_exchange_weak_explicit(&q->range, &range, job_range(next + 1, end),
+                memory_order_acq_rel, memory_order_acquire))
+            return (int)next;
+    }
+}
+
+// steal_jobs moves the back half of the jobs left in victim to thief, whose queue is
+// empty, false if victim had none
+static bool steal_jobs(JobQueue *thief, JobQueue *victim)
+{
+    uint64_t range = atomic_load_explicit(&victim->range, memory_order_acquire);
+    for (;;)
+    {
+        uint32_t next = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (next >= end)
+            return false;
+
+        uint32_t middle = end - (end - next + 1) / 2;
+        if (atomic_compare_exchange_weak_explicit(&victim->range, &range, job_range(next, middle),
+                memory_order_acq_rel, memory_order_acquire))
+        {
+            atomic_store_explicit(&thief->range, job_range(middle, end), memory_order_release);
+            thief->steals++;
+            return true;
+        }
+    }
+}
+
+// work runs jobs from the own queue of a thread and then steals, until every queue is empty
+static void work(JobPool *pool, JobQueue *own)
+{
+    for (;;)
+    {
+        int job;
+        while ((job = take_job(own)) >= 0)
+            pool->func(pool->user, job);
+
+        bool stolen = false;
+        for (int i = 1; i < pool->threads && !stolen; i++)
+            stolen = steal_jobs(own, &pool->queues[(own->id + i) % pool->threads]);
+        if (!stolen)
+            return;
+    }
+}
+
+static void *job_thread(void *arg)
+{
+    JobQueue *own = arg;
+    JobPool *pool = own->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        work(pool, own);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+// job_pool_init starts threads - 1 workers, the thread calling job_pool_run is the last one
+int job_pool_init(JobPool *pool, int threads)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > JOB_POOL_MAX_THREADS)
+        threads = JOB_POOL_MAX_THREADS;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->generation = 0;
+    pool->running = 0;
+    pool->stop = false;
+    pool->func = NULL;
+    pool->user = NULL;
+
+    for (int i = 0; i < threads; i++)
+    {
+        atomic_init(&pool->queues[i].range, 0);
+        pool->queues[i].steals = 0;
+        pool->queues[i].pool = pool;
+        pool->queues[i].id = i;
+    }
+
+    pool->threads = 1;
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&pool->workers[i], NULL, job_thread, &pool->queues[i]) != 0)
+        {
+            fprintf(stderr, "Could not start job thread %d\n", i);
+            job_pool_free(pool);
+            return -1;
+        }
+        pool->threads++;
+    }
+
+    return 0;
+}
+
+// job_pool_run calls func(user, job) for every job in [0, jobs) on the pool's threads,
+// in no particular order, and returns when all calls have returned. Only one run at a time.
+void job_pool_run(JobPool *pool, JobFunc func, void *user, int jobs)
+{
+    if (jobs <= 0)
+        return;
+    if (pool->threads == 1 || jobs == 1)
+    {
+        for (int job = 0; job < jobs; job++)
+            func(user, job);
+        return;
+    }
+
+    pool->func = func;
+    pool->user = user;
+    for (int i = 0; i < pool->threads; i++)
+    {
+        uint32_t begin = (uint32_t)((int64_t)jobs * i / pool->threads);
+        uint32_t end = (uint32_t)((int64_t)jobs * (i + 1) / pool->threads);
+        atomic_store_explicit(&pool->queues[i].range, job_range(begin, end), memory_order_relaxed);
+    }
+
+    // the lock publishes the queues and the job to the workers
+    pthread_mutex_lock(&pool->lock);
+    pool->generation++;
+    pool->running = pool->threads - 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, &pool->queues[0]);
+
+    // and makes everything the workers wrote visible here
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// job_pool_steals counts the steals of every run so far, call it between runs
+long job_pool_steals(const JobPool *pool)
+{
+    long steals = 0;
+    for (int i = 0; i < pool->threads; i++)
+        steals += pool->queues[i].steals;
+
+    return steals;
+}
+
+void job_pool_free(JobPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threads; i++)
+        pthread_join(pool->workers[i], NULL);
+    pool->threads = 1;
+
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// most threads a pool runs on, the caller included
+#define JOB_POOL_MAX_THREADS 64
+
+typedef void (*JobFunc)(void *user, int job);
+
+// JobQueue holds the jobs a worker has yet to run as one range, the next job in the
+// low 32 bits and the end in the high 32 bits, so that the owner taking from the
+// front and thieves taking from the back only ever race on one compare and swap.
+// Each queue has a cache line of its own.
+typedef struct JobQueue
+{
+    _Alignas(64) _Atomic uint64_t range;
+    long steals; // written by the owner only
+    struct JobPool *pool;
+    int id;
+} JobQueue;
+
+// JobPool runs a batch of jobs on a fixed set of threads and returns once all are done.
+// Every run hands each thread an even share of the jobs; a thread that runs out
+// steals half of what another has left.
+typedef struct JobPool
+{
+    int threads; // the caller is thread 0
+    pthread_t workers[JOB_POOL_MAX_THREADS];
+    JobQueue queues[JOB_POOL_MAX_THREADS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation; // runs started, with lock
+    int running; // workers still busy in this run, with lock
+    bool stop;
+
+    JobFunc func;
+    void *user;
+} JobPool;
+
+int job_pool_init(JobPool *pool, int threads);
+void job_pool_run(JobPool *pool, JobFunc func, void *user, int jobs);
+long job_pool_steals(const JobPool *pool);
+void job_pool_free(JobPool *pool);
@@ -1,57 +1,350 @@
-#include "libswresample/swresample.h"
-#include "libavformat/avformat.h"
-#include "libavcodec/avcodec.h"
-#include "libavutil/opt.h"
+#include "bands.h"
+#include "beats.h"
+#include "bench.h"
+#include "cache.h"
+#include "decode.h"
+#include "draw.h"
+#include "pacing.h"
+#include "particles.h"
+#include "peaks.h"
+#include "playback.h"
+#include "profile.h"
+#include "scene.h"
+#include "segment.h"
+#include "spectrogram.h"
+#include "spectrum.h"
+#include "timing.h"
+#include "track.h"
+#include "video.h"
 
 #include "raylib.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
-int decode_audio_file(const char *path, const int sample_rate, int *channel_count, double **data, int *size);
+// log_cache_verify reports how the check of a mapped cache entry ended
+static void log_cache_verify(CacheVerifyStatus status, const CacheVerifier *verifier)
+{
+    if (status == CACHE_VERIFY_OK)
+        TraceLog(LOG_INFO, "MUSICVIZ: Cache entry verified in %.2f s", verifier->seconds);
+    else if (status == CACHE_VERIFY_REBUILDING)
+        TraceLog(LOG_WARNING, "MUSICVIZ: Cache entry %s is corrupt, rebuilding it in the background", verifier->key.path);
+    else if (status == CACHE_VERIFY_REBUILT)
+        TraceLog(LOG_WARNING, "MUSICVIZ: Corrupt cache entry %s rebuilt", verifier->key.path);
+    else if (status == CACHE_VERIFY_FAILED)
+        TraceLog(LOG_WARNING, "MUSICVIZ: Corrupt cache entry %s removed, could not rebuild it", verifier->key.path);
+}
 
-int main(void)
+int main(int argc, char **argv)
 {
     const int screenWidth = 800;
     const int screenHeight = 450;
 
+    double startTime = now_seconds();
+
+    if (argc > 1 && strcmp(argv[1], "--bench-decode") == 0)
+        return bench_decode(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--bench-segments") == 0)
+        return bench_segments(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--bench-allocations") == 0)
+        return bench_allocations();
+    if (argc > 1 && strcmp(argv[1], "--bench-peaks") == 0)
+        return bench_peaks();
+    if (argc > 1 && strcmp(argv[1], "--bench-raster") == 0)
+        return bench_raster();
+    if (argc > 1 && strcmp(argv[1], "--bench-fft") == 0)
+        return bench_fft();
+    if (argc > 1 && strcmp(argv[1], "--bench-spectrogram") == 0)
+        return bench_spectrogram();
+    if (argc > 1 && strcmp(argv[1], "--bench-bands") == 0)
+        return bench_bands();
+    if (argc > 1 && strcmp(argv[1], "--bench-beats") == 0)
+        return bench_beats();
+    if (argc > 1 && strcmp(argv[1], "--bench-tap") == 0)
+        return bench_tap();
+    if (argc > 1 && strcmp(argv[1], "--bench-stalls") == 0)
+        return bench_stalls(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--bench-pacing") == 0)
+        return bench_pacing();
+    if (argc > 1 && strcmp(argv[1], "--bench-profile") == 0)
+        return bench_profile();
+    if (argc > 1 && strcmp(argv[1], "--bench-particles") == 0)
+        return bench_particles();
+
+    const char *filepath = "./resources/Crystal Castles - Celestica.mp3";
+    DecodeOptions decodeOptions = { .sample_rate = 0, .channels = 0, .format = SAMPLE_FORMAT_F32, .threads = 0 };
+    int segments = 0;
+    bool useCache = true;
+    int fftSize = 8192;
+    int hop = 0;
+    BandOptions bandOptions = { .count = 128, .scale = BAND_SCALE_LOG, .min_hz = 30.0f, .max_hz = 16000.0f };
+    PacingMode pacing = PACING_CAP;
+    int maxFps = 0;
+    bool showProfile = false;
+    const char *tracePath = NULL;
+    int particleThreads = 1;
+    VideoOptions videoOptions = { .path = NULL, .title = NULL, .width = screenWidth, .height = screenHeight, .fps = 60, .fft_size = 0 };
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--s16") == 0)
+            decodeOptions.format = SAMPLE_FORMAT_S16; // store 16 bit samples, half the memory of float
+        else if (strcmp(argv[i], "--no-cache") == 0)
+            useCache = false;
+        else if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc)
+            segments = atoi(argv[++i]); // decode the whole file up front on this many threads
+        else if (strcmp(argv[i], "--fft") == 0 && i + 1 < argc)
+            fftSize = atoi(argv[++i]); // spectrum analysis size, a power of two
+        else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc)
+            hop = atoi(argv[++i]); // frames between spectrogram columns
+        else if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc)
+            bandOptions.count = atoi(argv[++i]); // 0 draws the linear FFT bins
+        else if (strcmp(argv[i], "--band-scale") == 0 && i + 1 < argc)
+            bandOptions.scale = strcmp(argv[++i], "mel") == 0 ? BAND_SCALE_MEL : BAND_SCALE_LOG;
+        else if (strcmp(argv[i], "--band-range") == 0 && i + 2 < argc)
+        {
+            bandOptions.min_hz = atof(argv[++i]);
+            bandOptions.max_hz = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc)
+            videoOptions.path = argv[++i]; // no window, encode the visualization to this file
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            videoOptions.fps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc)
+        {
+            // free renders flat out, cap sleeps to the frame rate, change also skips unchanged frames
+            if (pacing_mode_parse(argv[++i], &pacing) != 0)
+            {
+                fprintf(stderr, "--pacing takes free, cap or change\n");
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc)
+            maxFps = atoi(argv[++i]); // frame rate cap, the display refresh rate by default
+        else if (strcmp(argv[i], "--profile") == 0)
+            showProfile = true; // start with the stage timing overlay, F1 toggles it
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i]; // time every stage and write the trace here on exit, CSV for .csv
+        else if (strcmp(argv[i], "--particle-threads") == 0 && i + 1 < argc)
+            particleThreads = atoi(argv[++i]); // update the particles on a job pool of this many threads
+        else
+            filepath = argv[i];
+    }
+
+    if (fftSize < FFT_MIN_SIZE || fftSize > FFT_MAX_SIZE || (fftSize & (fftSize - 1)) != 0)
+    {
+        fprintf(stderr, "--fft takes a power of two from %d to %d\n", FFT_MIN_SIZE, FFT_MAX_SIZE);
+        return -1;
+    }
+    if (hop <= 0)
+        hop = fftSize / 4;
+    videoOptions.fft_size = fftSize;
+    videoOptions.hop = hop;
+    videoOptions.bands = bandOptions;
+
+    // a render needs the whole track before the first frame, decode it on every core
+    if (videoOptions.path && segments <= 0)
+        segments = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    // a track decoded on an earlier run is mapped straight from the cache
+    Track track;
+    CacheKey cacheKey;
+    CacheWriter cacheWriter = { .running = false };
+    CacheVerifier cacheVerifier = { .running = false };
+    CacheStatus cacheStatus = CACHE_MISS;
+    bool cacheKeyed = false;
+    if (useCache)
+    {
+        double cacheStart = now_seconds();
+        cacheKeyed = cache_key(&cacheKey, filepath, &decodeOptions) == 0;
+        if (cacheKeyed)
+            cacheStatus = cache_load(&cacheKey, &track);
+
+        if (cacheStatus == CACHE_HIT)
+        {
+            TraceLog(LOG_INFO, "MUSICVIZ: Cache hit, %d frames mapped in %.2f ms", track.size, (now_seconds() - cacheStart) * 1000.0);
+            cache_verifier_start(&cacheVerifier, &cacheKey, &track, filepath, &decodeOptions);
+        }
+        else if (cacheStatus == CACHE_INVALID)
+            TraceLog(LOG_WARNING, "MUSICVIZ: Cache entry %s was stale or corrupt, rebuilding", cacheKey.path);
+        else
+            TraceLog(LOG_INFO, "MUSICVIZ: Cache miss, file hashed in %.2f ms", (now_seconds() - cacheStart) * 1000.0);
+    }
+
+    // decode in the background so drawing can start right away, unless an offline
+    // segmented decode was asked for. the same samples feed the audio device and the waveform.
+    bool streaming = cacheStatus != CACHE_HIT && segments <= 0;
+    Decoder decoder;
+    if (cacheStatus == CACHE_HIT)
+    {
+        // nothing to decode
+    }
+    else if (streaming)
+    {
+        if (decoder_start(&decoder, filepath, &decodeOptions) != 0)
+        {
+            return -1;
+        }
+        track_init(&track, decoder.source.sample_rate, decoder.source.channels, decodeOptions.format);
+        track_reserve(&track, decode_expected_frames(&decoder.source));
+    }
+    else if (decode_file_segmented(filepath, &decodeOptions, segments, &track) != 0)
+    {
+        return -1;
+    }
+
+    if (videoOptions.path)
+    {
+        videoOptions.title = GetFileNameWithoutExt(filepath);
+        int ret = video_render(&track, &videoOptions);
+        if (ret == 0 && cacheKeyed && cacheStatus != CACHE_HIT && cache_store(&cacheKey, &track) != 0)
+            TraceLog(LOG_WARNING, "MUSICVIZ: Could not write cache entry %s", cacheKey.path);
+        if (cacheVerifier.running)
+            log_cache_verify(cache_verifier_join(&cacheVerifier), &cacheVerifier);
+        track_free(&track);
+        return ret;
+    }
+
     InitWindow(screenWidth, screenHeight, "");
     InitAudioDevice();
-    const char *filepath = "./resources/Crystal Castles - Celestica.mp3";
-    Music music = LoadMusicStream(filepath);
     SetMasterVolume(1);
-    PlayMusicStream(music);
 
     char *Song = (char *)malloc(128 * sizeof(char));
     Song = GetFileNameWithoutExt(filepath);
 
-    float timePlayed = 0.0f;
     bool pause = false;
 
-    SetTargetFPS(100000);
+    // frames are paced here rather than by raylib, which only sleeps in EndDrawing
+    if (pacing == PACING_FREE)
+        SetTargetFPS(100000);
+    else
+        SetTargetFPS(0);
+    if (maxFps <= 0)
+        maxFps = GetMonitorRefreshRate(GetCurrentMonitor());
+    if (maxFps <= 0)
+        maxFps = 60;
 
-    int sample_rate = music.stream.sampleRate;
-    int channel_count = 0;
-    double *data;
-    int size;
+    int sample_rate = track.sample_rate;
 
-    if (decode_audio_file(filepath, sample_rate, &channel_count, &data, &size) != 0)
+    Playback playback;
+    if (playback_init(&playback, sample_rate, track.channels, track.format) != 0)
     {
+        if (streaming)
+            decoder_stop(&decoder);
         return -1;
     }
-
-    int cursor = 0;
-
-    Vector2 *pts = malloc(sizeof(Vector2) * size);
+    // the device is refilled from its own thread, the render loop only does it as a fallback
+    bool audioThread = playback_start(&playback, &track) == 0;
+    if (!audioThread)
+        TraceLog(LOG_WARNING, "MUSICVIZ: Could not start the audio thread, refilling from the render loop");
+
+    bool firstFrameReported = false;
+    bool decodeReported = false;
+
+    // min/max pyramid for the zoomed out waveform and the whole track overview
+    Peaks peaks;
+    peaks_init(&peaks, streaming ? decode_expected_frames(&decoder.source) : track.size);
+    int framesPerColumn = 1; // waveform zoom, changed with up/down
+
+    Scene scene;
+    DrawBackend draw;
+    scene_init(&scene, Song, screenWidth, screenHeight);
+    draw_backend_gl(&draw);
+
+    // analyzed live around the cursor until the spectrogram of the whole track,
+    // built in the background once the track is complete, is ready
+    Spectrum spectrum;
+    spectrum_init(&spectrum, fftSize);
+    Spectrogram spectrogram = { .levels = NULL };
+    SpectrogramBuilder spectrogramBuilder = { .running = false };
+    int spectrogramThreads = 1;
+
+    // log, constant Q or mel bands instead of linear bins, unless turned off
+    Bands bands = { .count = 0 };
+    if (bandOptions.count > 0 && bands_init(&bands, &bandOptions, fftSize, sample_rate) != 0)
+        TraceLog(LOG_WARNING, "MUSICVIZ: Invalid band range %.0f-%.0f Hz, drawing FFT bins", bandOptions.min_hz, bandOptions.max_hz);
+    float *levels = malloc(sizeof(float) * (bands.count > 0 ? bands.count : spectrum.bins));
+    int levelCount = bands.count > 0 ? bands.count : spectrum.bins;
+
+    // onsets and beats are found on the decoded part of the track, ahead of playback,
+    // and burst particles from the waveform when playback reaches them
+    BeatTracker beats;
+    beat_tracker_init(&beats, sample_rate);
+    BeatCursor onsetCursor = { .next = 0, .frame = 0 };
+    BeatCursor beatCursor = { .next = 0, .frame = 0 };
+    bool beatsReported = false;
+    BeatParticles particles;
+    beat_particles_init(&particles, (Vector2){ screenWidth / 2.0f, screenHeight - 60 }, particleThreads);
+
+    // the raw waveform is read back from the samples handed to the device
+    float *heard = malloc(sizeof(float) * screenWidth);
+    double tapLatencySum = 0.0;
+    double tapLatencyMax = 0.0;
+    long tapReads = 0;
+
+    // stage timers record while the overlay is up or a trace was asked for
+    profile_enable(showProfile || tracePath);
+    ProfileStats profileStats[PROFILE_STAGES];
+
+    FramePacer pacer;
+    frame_pacer_init(&pacer, pacing, maxFps);
+    long drawnColumn = -1;
+    int drawnZoom = 0;
+    int drawnSize = -1;
+    unsigned long drawnParticles = 0;
+    bool drawnSpectrogram = false;
+    CacheVerifyStatus verifyReported = CACHE_VERIFY_RUNNING;
 
     while (!WindowShouldClose())
     {
-        UpdateMusicStream(music);
+        double stageStart = profile_begin();
+        double frameTime = frame_pacer_wait(&pacer);
+        profile_end(PROFILE_PACING, stageStart);
+
+        stageStart = profile_begin();
+        if (streaming)
+        {
+            // appending may move the track under the audio thread
+            playback_lock(&playback);
+            decoder_drain(&decoder, &track);
+            playback_unlock(&playback);
+
+            // the decoded part still plays, but is neither analyzed as a whole nor cached
+            if (!decodeReported && decoder_status(&decoder) != 0)
+            {
+                TraceLog(LOG_WARNING, "MUSICVIZ: Decoding failed after %d frames, not caching the track", track.size);
+                decodeReported = true;
+            }
+        }
+        if (!audioThread)
+            playback_update(&playback, &track);
+        profile_end(PROFILE_AUDIO, stageStart);
+
+        stageStart = profile_begin();
+        peaks_update(&peaks, &track, 1 << 19);
+        beat_tracker_update(&beats, &track, 128);
+        profile_end(PROFILE_ANALYSIS, stageStart);
+
+        if (IsKeyPressed(KEY_UP) && framesPerColumn < (1 << 16))
+            framesPerColumn *= 2;
+        if (IsKeyPressed(KEY_DOWN) && framesPerColumn > 1)
+            framesPerColumn /= 2;
+
+        if (IsKeyPressed(KEY_F1))
+        {
+            showProfile = !showProfile;
+            profile_enable(showProfile || tracePath);
+        }
+        if (IsKeyPressed(KEY_F2) && profile_export("musicviz-trace.json") >= 0)
+            TraceLog(LOG_INFO, "MUSICVIZ: Trace written to musicviz-trace.json");
+        if (IsKeyPressed(KEY_F3) && profile_export("musicviz-trace.csv") >= 0)
+            TraceLog(LOG_INFO, "MUSICVIZ: Trace written to musicviz-trace.csv");
 
         if (IsKeyPressed(KEY_R))
         {
-            StopMusicStream(music);
-            PlayMusicStream(music);
+            playback_restart(&playback);
         }
 
         if (IsKeyPressed(KEY_SPACE))
@@ -59,158 +352,210 @@ int main(void)
             pause = !pause;
 
             if (pause)
-                PauseMusicStream(music);
+                playback_pause(&playback);
             else
-                ResumeMusicStream(music);
+                playback_resume(&playback);
         }
 
-        timePlayed = GetMusicTimePlayed(music) / GetMusicTimeLength(music) * screenWidth;
-
-        BeginDrawing();
-        DrawFPS(20, 20);
-        ClearBackground(RAYWHITE);
-
-        DrawText(Song, (screenWidth - MeasureText(Song, 50)) / 2,
-            (screenHeight - 150) / 2, 50, DARKGRAY);
-
-        DrawRectangle(0, screenHeight - 20, screenWidth, 20, LIGHTGRAY);
-        DrawRectangle(0, screenHeight - 20, (int)timePlayed * 2, 20, MAROON);
-
-        //TODO: check out https://github.com/Crelloc/Music-Visualizer-Reboot/
-
-        for (int i = 0; i < screenWidth; i++)
+        double playedFrame = playback_frame(&playback);
+
+        stageStart = profile_begin();
+        int fired = beat_cursor_advance(&beatCursor, &beats.beats, (int)playedFrame);
+        for (int i = beatCursor.next - fired; i < beatCursor.next; i++)
+            beat_particles_fire(&particles, &beats.beats.events[i]);
+        fired = beat_cursor_advance(&onsetCursor, &beats.onsets, (int)playedFrame);
+        for (int i = onsetCursor.next - fired; i < onsetCursor.next; i++)
+            beat_particles_fire(&particles, &beats.onsets.events[i]);
+        unsigned long particleCount = beat_particles_update(&particles, (float)frameTime);
+        profile_end(PROFILE_PARTICLES, stageStart);
+
+        // unless the cursor moved a column, the track grew, or particles are flying,
+        // the last frame is left on screen and only the input is polled
+        long column = (long)(playedFrame / framesPerColumn);
+        bool redraw = pacing != PACING_ON_CHANGE || column != drawnColumn || framesPerColumn != drawnZoom ||
+            track.size != drawnSize || particleCount > 0 || drawnParticles > 0 ||
+            (spectrogram.levels != NULL) != drawnSpectrogram || showProfile;
+        if (redraw)
         {
-            pts[i] = (Vector2){i, (screenHeight - 60 - data[(int)(((timePlayed * GetMusicTimeLength(music)) / 800) * sample_rate) + i]) - data[(int)(((timePlayed * GetMusicTimeLength(music)) / 800) * sample_rate) + i] * 15};
+            drawnColumn = column;
+            drawnZoom = framesPerColumn;
+            drawnSize = track.size;
+            drawnParticles = particleCount;
+            drawnSpectrogram = spectrogram.levels != NULL;
+
+            stageStart = profile_begin();
+            if (spectrogram.levels)
+            {
+                spectrogram_levels(&spectrogram, playedFrame, levels);
+            }
+            else
+            {
+                spectrum_update(&spectrum, &track, playedFrame);
+                if (bands.count > 0)
+                    bands_apply(&bands, spectrum.magnitude, levels);
+                else
+                    memcpy(levels, spectrum.db, sizeof(float) * spectrum.bins);
+            }
+            profile_end(PROFILE_ANALYSIS, stageStart);
+
+            double pushedTime = 0.0;
+            int heardCount = audio_tap_read(playback.tap, playback_tap_position(&playback), heard, screenWidth, &pushedTime);
+
+            // the container duration is only an estimate until everything is decoded
+            SceneState state = {
+                .track = &track,
+                .peaks = &peaks,
+                .played_frame = playedFrame,
+                .time_length = track.complete ? (double)track.size / sample_rate : decoder.source.duration,
+                .frames_per_column = framesPerColumn,
+                .waveform = heardCount > 0 ? heard : NULL,
+                .spectrum = levels,
+                .spectrum_bins = levelCount,
+            };
+
+            if (showProfile)
+                profile_summarize(profileStats);
+
+            stageStart = profile_begin();
+            BeginDrawing();
+            DrawFPS(20, 20);
+            //TODO: check out https://github.com/Crelloc/Music-Visualizer-Reboot/
+            scene_draw(&scene, &draw, &state);
+            beat_particles_draw(&particles);
+            if (showProfile)
+                profile_draw(&draw, profileStats, 20, 50);
+            profile_end(PROFILE_DRAW, stageStart);
+
+            stageStart = profile_begin();
+            EndDrawing();
+            profile_end(PROFILE_SWAP, stageStart);
+            frame_pacer_redrawn(&pacer);
+
+            // time from handing the samples to raylib to showing them, the device
+            // buffer they still wait in before they are heard is not included
+            if (heardCount > 0 && pushedTime > 0.0)
+            {
+                double latency = now_seconds() - pushedTime;
+                tapLatencySum += latency;
+                if (latency > tapLatencyMax)
+                    tapLatencyMax = latency;
+                tapReads++;
+            }
+        }
+        else
+        {
+            stageStart = profile_begin();
+            PollInputEvents();
+            profile_end(PROFILE_SWAP, stageStart);
         }
 
-        DrawLineStrip(pts, screenWidth, BLACK);
-        EndDrawing();
-    }
-
-    UnloadMusicStream(music);
-    CloseAudioDevice();
-    CloseWindow();
-
-    return 0;
-}
-
-int decode_audio_file(const char *path, const int sample_rate, int *channel_count, double **data, int *size)
-{
-
-    // initialize all muxers, demuxers and protocols for libavformat
-    // (does nothing if called twice during the course of one program execution)
-    av_register_all();
-
-    // get format from audio file
-    AVFormatContext *format = avformat_alloc_context();
-    if (avformat_open_input(&format, path, NULL, NULL) != 0)
-    {
-        fprintf(stderr, "Could not open file '%s'\n", path);
-        return -1;
-    }
-    if (avformat_find_stream_info(format, NULL) < 0)
-    {
-        fprintf(stderr, "Could not retrieve stream info from file '%s'\n", path);
-        return -1;
-    }
-
-    // Find the index of the first audio stream
-    int stream_index = -1;
-    for (int i = 0; i < format->nb_streams; i++)
-    {
-        if (format->streams[i]->codec->codec_type == AVMEDIA_TYPE_AUDIO)
+        if (!firstFrameReported && track.size > 0)
         {
-            stream_index = i;
-            break;
+            TraceLog(LOG_INFO, "MUSICVIZ: First waveform frame after %.2f ms (%d samples decoded)",
+                (now_seconds() - startTime) * 1000.0, track.size);
+            firstFrameReported = true;
+        }
+        if (!decodeReported && track.complete)
+        {
+            TraceLog(LOG_INFO, "MUSICVIZ: Decoded %d frames in %.2f s",
+                track.size, now_seconds() - startTime);
+            if (streaming)
+            {
+                TraceLog(LOG_INFO, "MUSICVIZ: Decode CPU %.2f s (single pass), allocations: %d scratch, %d track",
+                    decoder.cpu_seconds, decoder.source.allocations, track.allocations);
+            }
+            TraceLog(LOG_INFO, "MUSICVIZ: Track uses %.1f MB (%d bytes per frame)",
+                (double)track.size * track.frame_size / (1024.0 * 1024.0), track.frame_size);
+            decodeReported = true;
+
+            // leave a core to the render thread
+            int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            spectrogramThreads = cores > 1 ? cores - 1 : 1;
+            if (spectrogram_builder_start(&spectrogramBuilder, &track, fftSize, hop, bands.count > 0 ? &bands : NULL, spectrogramThreads) != 0)
+                TraceLog(LOG_WARNING, "MUSICVIZ: Could not start the spectrogram thread, analyzing live");
+
+            // a streamed track is only complete when decode_run succeeded
+            if (cacheKeyed && cacheStatus != CACHE_HIT && (!streaming || decoder_status(&decoder) == 0))
+                cache_writer_start(&cacheWriter, &cacheKey, &track);
+        }
+        if (spectrogram_builder_done(&spectrogramBuilder))
+        {
+            if (spectrogram_builder_join(&spectrogramBuilder, &spectrogram) == 0)
+            {
+                TraceLog(LOG_INFO, "MUSICVIZ: Spectrogram of %d columns built in %.2f s (%.3f s per minute of audio) on %d threads, %.1f MB",
+                    spectrogram.columns, spectrogram.build_seconds, spectrogram.build_seconds * 60.0 * sample_rate / track.size,
+                    spectrogramThreads, spectrogram_bytes(&spectrogram) / (1024.0 * 1024.0));
+            }
+            else
+            {
+                TraceLog(LOG_WARNING, "MUSICVIZ: Could not build the spectrogram, analyzing live");
+            }
+        }
+        if (cacheVerifier.running && cache_verifier_status(&cacheVerifier) != verifyReported)
+        {
+            verifyReported = cache_verifier_status(&cacheVerifier);
+            log_cache_verify(verifyReported, &cacheVerifier);
+        }
+        if (!beatsReported && beats.finished)
+        {
+            TraceLog(LOG_INFO, "MUSICVIZ: %d onsets and %d beats at %.1f BPM found in %.2f s",
+                beats.onsets.count, beats.beats.count, beat_tracker_bpm(&beats), beats.seconds);
+            beatsReported = true;
         }
     }
-    if (stream_index == -1)
-    {
-        fprintf(stderr, "Could not retrieve audio stream from file '%s'\n", path);
-        return -1;
-    }
-    AVStream *stream = format->streams[stream_index];
-
-    // find & open codec
-    AVCodecContext* codec_ctx = stream->codec;
-    AVCodec *codec = codec_ctx->codec;
-
-    codec_ctx->thread_count = 0; // set codec to automatically determine how many threads suits best for the decoding job
 
-    if (codec->capabilities | AV_CODEC_CAP_FRAME_THREADS)
-    codec_ctx->thread_type = FF_THREAD_FRAME;
-    else if (codec->capabilities | AV_CODEC_CAP_SLICE_THREADS)
-    codec_ctx->thread_type = FF_THREAD_SLICE;
-    else
-    codec_ctx->thread_count = 1; //don't use multithreading
-
-    if (avcodec_open2(codec_ctx, avcodec_find_decoder(codec_ctx->codec_id), NULL) < 0) {
-    AVCodecContext *codec = stream->codec;
-    if (avcodec_open2(codec, avcodec_find_decoder(codec->codec_id), NULL) < 0)
+    // the build reads the track and bands freed below
+    if (spectrogramBuilder.running)
+        spectrogram_builder_join(&spectrogramBuilder, &spectrogram);
+    if (cacheWriter.running)
     {
-        fprintf(stderr, "Failed to open decoder for stream #%u in file '%s'\n", stream_index, path);
-        return -1;
+        if (cache_writer_join(&cacheWriter) == 0)
+            TraceLog(LOG_INFO, "MUSICVIZ: Cache entry written in %.2f s", cacheWriter.seconds);
+        else
+            TraceLog(LOG_WARNING, "MUSICVIZ: Could not write cache entry %s", cacheKey.path);
     }
-
-    *channel_count = codec->channels;
-
-    // prepare resampler
-    struct SwrContext* swr = swr_alloc();
-    av_opt_set_int(swr, "in_channel_count",  codec_ctx->channels, 0);
-    av_opt_set_int(swr, "out_channel_count", 1, 0);
-    av_opt_set_int(swr, "in_channel_layout",  codec_ctx->channel_layout, 0);
-    av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_MONO, 0);
-    av_opt_set_int(swr, "in_sample_rate", codec_ctx->sample_rate, 0);
-    av_opt_set_int(swr, "out_sample_rate", sample_rate, 0);
-    av_opt_set_sample_fmt(swr, "in_sample_fmt",  codec_ctx->sample_fmt, 0);
-    av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_DBL,  0);
-    swr_init(swr);
-    if (!swr_is_initialized(swr))
+    if (cacheVerifier.running)
     {
-        fprintf(stderr, "Resampler has not been properly initialized\n");
-        return -1;
+        CacheVerifyStatus status = cache_verifier_join(&cacheVerifier);
+        if (status != verifyReported)
+            log_cache_verify(status, &cacheVerifier);
     }
 
-    // prepare to read data
-    AVPacket packet;
-    av_init_packet(&packet);
-    AVFrame *frame = av_frame_alloc();
-    if (!frame)
+    if (tapReads > 0)
     {
-        fprintf(stderr, "Error allocating the frame\n");
-        return -1;
+        TraceLog(LOG_INFO, "MUSICVIZ: Hand-off to screen latency (device buffer excluded) %.1f ms average, %.1f ms max, %ld overruns, %ld underruns",
+            tapLatencySum / tapReads * 1000.0, tapLatencyMax * 1000.0, playback.tap->overruns, playback.tap->underruns);
     }
 
-    // iterate through frames
-    *data = NULL;
-    *size = 0;
-    while (av_read_frame(format, &packet) >= 0)
+    if (tracePath)
     {
-        // decode one frame
-        int gotFrame;
-        if (avcodec_decode_audio4(codec_ctx, frame, &gotFrame, &packet) < 0) {
-            break;
-        }
-        if (!gotFrame)
-        {
-            continue;
-        }
-        // resample frames
-        double *buffer;
-        av_samples_alloc((uint8_t **)&buffer, NULL, 1, frame->nb_samples, AV_SAMPLE_FMT_DBL, 0);
-        int frame_count = swr_convert(swr, (uint8_t **)&buffer, frame->nb_samples, (const uint8_t **)frame->data, frame->nb_samples);
-        // append resampled frames to data
-        *data = (double *)realloc(*data, (*size + frame->nb_samples) * sizeof(double));
-        memcpy(*data + *size, buffer, frame_count * sizeof(double));
-        *size += frame_count;
+        int events = profile_export(tracePath);
+        if (events >= 0)
+            TraceLog(LOG_INFO, "MUSICVIZ: %d timed stages written to %s", events, tracePath);
     }
 
-    // clean up
-    av_frame_free(&frame);
-    swr_free(&swr);
-    avcodec_close(codec_ctx);
-    avformat_free_context(format);
+    FramePacerStats pacerStats;
+    frame_pacer_stats(&pacer, &pacerStats);
+    TraceLog(LOG_INFO, "MUSICVIZ: Pacing %s at %d fps: %.1f frames/s, %.1f redraws/s, frame time %.2f ms, jitter %.3f ms, max %.2f ms, render thread CPU %.1f%%",
+        pacing_mode_name(pacing), maxFps, pacerStats.fps, pacerStats.redraws_per_second, pacerStats.frame_ms,
+        pacerStats.jitter_ms, pacerStats.max_ms, pacerStats.cpu_percent);
+    TraceLog(LOG_INFO, "MUSICVIZ: %ld audio underruns", playback_underruns(&playback));
+    playback_free(&playback);
+    if (streaming)
+        decoder_stop(&decoder);
+    peaks_free(&peaks);
+    track_free(&track);
+    scene_free(&scene);
+    spectrum_free(&spectrum);
+    spectrogram_free(&spectrogram);
+    bands_free(&bands);
+    free(levels);
+    free(heard);
+    beat_particles_free(&particles);
+    beat_tracker_free(&beats);
+
+    CloseAudioDevice();
+    CloseWindow();
 
-    // success
     return 0;
 }
@@ -0,0 +1,122 @@
+#include "pacing.h"
+#include "timing.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+// bounds of the learned sleep slack, in seconds
+#define PACING_MIN_SLACK 0.00005
+#define PACING_MAX_SLACK 0.002
+
+static const char *mode_names[] = { "free", "cap", "change" };
+
+int pacing_mode_parse(const char *name, PacingMode *mode)
+{
+    for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++)
+    {
+        if (strcmp(name, mode_names[i]) == 0)
+        {
+            *mode = (PacingMode)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *pacing_mode_name(PacingMode mode)
+{
+    return mode_names[mode];
+}
+
+static double thread_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void frame_pacer_init(FramePacer *fp, PacingMode mode, int fps)
+{
+    fp->mode = mode;
+    fp->fps = fps;
+    fp->period = mode != PACING_FREE && fps > 0 ? 1.0 / fps : 0.0;
+    fp->slack = PACING_MAX_SLACK / 2;
+    fp->start = now_seconds();
+    fp->cpu_start = thread_cpu_seconds();
+    fp->last = fp->start;
+    fp->deadline = fp->start;
+    fp->frames = 0;
+    fp->redraws = 0;
+    fp->interval_sum = 0.0;
+    fp->interval_sq_sum = 0.0;
+    fp->interval_max = 0.0;
+}
+
+// frame_pacer_wait blocks until the next frame is due and returns the seconds since the
+// previous one. Most of the wait is slept; only the last bit, which a sleep may overshoot,
+// is spun.
+double frame_pacer_wait(FramePacer *fp)
+{
+    double now = now_seconds();
+    if (fp->period > 0.0)
+    {
+        double wake = fp->deadline - fp->slack;
+        if (now < wake)
+        {
+            struct timespec ts = { (time_t)wake, (long)((wake - floor(wake)) * 1e9) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            now = now_seconds();
+
+            // keep the slack around twice the usual oversleep
+            double slack = 0.9 * fp->slack + 0.1 * 2.0 * (now - wake);
+            fp->slack = fmin(fmax(slack, PACING_MIN_SLACK), PACING_MAX_SLACK);
+        }
+        while (now < fp->deadline)
+            now = now_seconds();
+
+        // after a long frame start over rather than rushing frames to catch up
+        fp->deadline += fp->period;
+        if (fp->deadline < now)
+            fp->deadline = now + fp->period;
+    }
+
+    double interval = now - fp->last;
+    if (fp->frames > 0)
+    {
+        fp->interval_sum += interval;
+        fp->interval_sq_sum += interval * interval;
+        if (interval > fp->interval_max)
+            fp->interval_max = interval;
+    }
+    fp->last = now;
+    fp->frames++;
+
+    return interval;
+}
+
+void frame_pacer_redrawn(FramePacer *fp)
+{
+    fp->redraws++;
+}
+
+void frame_pacer_stats(const FramePacer *fp, FramePacerStats *stats)
+{
+    double elapsed = now_seconds() - fp->start;
+    long intervals = fp->frames - 1;
+
+    stats->fps = elapsed > 0.0 ? fp->frames / elapsed : 0.0;
+    stats->redraws_per_second = elapsed > 0.0 ? fp->redraws / elapsed : 0.0;
+    stats->frame_ms = 0.0;
+    stats->jitter_ms = 0.0;
+    stats->max_ms = fp->interval_max * 1000.0;
+    if (intervals > 0)
+    {
+        double mean = fp->interval_sum / intervals;
+        double variance = fp->interval_sq_sum / intervals - mean * mean;
+        stats->frame_ms = mean * 1000.0;
+        stats->jitter_ms = variance > 0.0 ? sqrt(variance) * 1000.0 : 0.0;
+    }
+    stats->cpu_percent = elapsed > 0.0 ? (thread_cpu_seconds() - fp->cpu_start) / elapsed * 100.0 : 0.0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+
+// PacingMode picks how the render loop is timed
+typedef enum PacingMode
+{
+    PACING_FREE, // render flat out
+    PACING_CAP, // sleep between frames to hold the frame rate cap
+    PACING_ON_CHANGE, // like PACING_CAP, but only redraw when something on screen moved
+} PacingMode;
+
+// FramePacer sleeps the render loop to a frame rate and keeps frame time statistics
+typedef struct FramePacer
+{
+    PacingMode mode;
+    int fps;
+    double period; // seconds per frame, 0 when free
+    double deadline; // start of the next frame
+    double slack; // the sleep ends this early and the rest is spun, learned from oversleeps
+    double last; // start of the current frame
+    double start;
+    double cpu_start; // thread CPU time at init
+    long frames;
+    long redraws;
+    double interval_sum;
+    double interval_sq_sum;
+    double interval_max;
+} FramePacer;
+
+// FramePacerStats summarizes a FramePacer since init
+typedef struct FramePacerStats
+{
+    double fps;
+    double redraws_per_second;
+    double frame_ms; // mean frame interval
+    double jitter_ms; // standard deviation of the frame interval
+    double max_ms;
+    double cpu_percent; // of one core, spent by the calling thread
+} FramePacerStats;
+
+int pacing_mode_parse(const char *name, PacingMode *mode);
+const char *pacing_mode_name(PacingMode mode);
+
+void frame_pacer_init(FramePacer *fp, PacingMode mode, int fps);
+double frame_pacer_wait(FramePacer *fp);
+void frame_pacer_redrawn(FramePacer *fp);
+void frame_pacer_stats(const FramePacer *fp, FramePacerStats *stats);
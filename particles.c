@@ -0,0 +1,473 @@
+#include "particles.h"
+
+#include "partikel.h"
+#include "timing.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// particles per burst at full strength
+#define BEAT_BURST 160
+#define ONSET_BURST 24
+
+// run_jobs is the ParticleSystem_Runner of a JobPool
+static void run_jobs(void *runner, ParticleSystem_Job job, void *user, int jobs)
+{
+    job_pool_run(runner, job, user, jobs);
+}
+
+// beat_particles_init makes the emitters, updated on threads threads when more than one
+int beat_particles_init(BeatParticles *bp, Vector2 origin, int threads)
+{
+    Image dot = GenImageGradientRadial(16, 16, 0.0f, WHITE, BLANK);
+    bp->texture = LoadTextureFromImage(dot);
+    UnloadImage(dot);
+
+    EmitterConfig beat = {
+        .direction = (Vector2){ 0, -1 },
+        .velocity = (FloatRange){ 60, 260 },
+        .directionAngle = (FloatRange){ -90, 90 },
+        .velocityAngle = (FloatRange){ 0, 0 },
+        .offset = (FloatRange){ 0, 8 },
+        .originAcceleration = (FloatRange){ 0, 0 },
+        .burst = (IntRange){ BEAT_BURST / 2, BEAT_BURST },
+        .capacity = 4 * BEAT_BURST,
+        .emissionRate = 0,
+        .origin = origin,
+        .externalAcceleration = (Vector2){ 0, 120 },
+        .startColor = (Color){ 190, 33, 55, 255 },
+        .endColor = (Color){ 190, 33, 55, 0 },
+        .age = (FloatRange){ 0.4f, 1.2f },
+        .blendMode = BLEND_ALPHA,
+        .texture = bp->texture,
+        .particle_Deactivator = NULL,
+    };
+    EmitterConfig onset = beat;
+    onset.velocity = (FloatRange){ 30, 120 };
+    onset.directionAngle = (FloatRange){ -180, 180 };
+    onset.burst = (IntRange){ ONSET_BURST / 2, ONSET_BURST };
+    onset.capacity = 8 * ONSET_BURST;
+    onset.externalAcceleration = (Vector2){ 0, 0 };
+    onset.startColor = (Color){ 80, 80, 80, 200 };
+    onset.endColor = (Color){ 80, 80, 80, 0 };
+    onset.age = (FloatRange){ 0.2f, 0.5f };
+
+    bp->threaded = false;
+    bp->system = ParticleSystem_New();
+    bp->beat = Emitter_New(beat);
+    bp->onset = Emitter_New(onset);
+    if (!bp->system || !bp->beat || !bp->onset
+        || !ParticleSystem_Register(bp->system, bp->beat) || !ParticleSystem_Register(bp->system, bp->onset))
+    {
+        beat_particles_free(bp);
+        return -1;
+    }
+
+    if (threads > 1 && job_pool_init(&bp->jobs, threads) == 0)
+    {
+        bp->threaded = true;
+        ParticleSystem_SetRunner(bp->system, run_jobs, &bp->jobs);
+    }
+
+    return 0;
+}
+
+// beat_particles_fire bursts the emitter of the event's kind, bigger for stronger events
+void beat_particles_fire(BeatParticles *bp, const BeatEvent *event)
+{
+    Emitter *e = event->kind == BEAT_BEAT ? bp->beat : bp->onset;
+    int full = event->kind == BEAT_BEAT ? BEAT_BURST : ONSET_BURST;
+    float strength = event->strength < 0.25f ? 0.25f : event->strength;
+
+    e->config.burst.max = (int)(full * strength);
+    e->config.burst.min = e->config.burst.max / 2;
+    Emitter_Burst(e);
+}
+
+unsigned long beat_particles_update(BeatParticles *bp, float dt)
+{
+    return ParticleSystem_Update(bp->system, dt);
+}
+
+void beat_particles_draw(BeatParticles *bp)
+{
+    ParticleSystem_Draw(bp->system);
+}
+
+void beat_particles_free(BeatParticles *bp)
+{
+    if (bp->beat)
+        Emitter_Free(bp->beat);
+    if (bp->onset)
+        Emitter_Free(bp->onset);
+    if (bp->system)
+        ParticleSystem_Free(bp->system);
+    if (bp->threaded)
+        job_pool_free(&bp->jobs);
+    bp->threaded = false;
+    UnloadTexture(bp->texture);
+    bp->system = NULL;
+    bp->beat = NULL;
+    bp->onset = NULL;
+}
+
+// bench_config is an emitter with room for capacity particles bursting count of them,
+// pulled towards its origin, the same ones for the same seed
+static EmitterConfig bench_config(size_t count, size_t capacity, unsigned int seed)
+{
+    EmitterConfig cfg = {
+        .direction = (Vector2){ 0, -1 },
+        .velocity = (FloatRange){ 60, 260 },
+        .directionAngle = (FloatRange){ -180, 180 },
+        .velocityAngle = (FloatRange){ 0, 0 },
+        .offset = (FloatRange){ 0, 8 },
+        .originAcceleration = (FloatRange){ 10, 50 },
+        .burst = (IntRange){ (int)count, (int)count },
+        .capacity = capacity,
+        .emissionRate = 0,
+        .origin = (Vector2){ 400, 225 },
+        .externalAcceleration = (Vector2){ 0, 120 },
+        .age = (FloatRange){ 1000.0f, 2000.0f },
+        .seed = seed,
+        .particle_Deactivator = NULL,
+    };
+
+    return cfg;
+}
+
+// bench_emitter makes an emitter of bench_config with its burst of particles live
+static Emitter *bench_emitter(size_t count, size_t capacity, unsigned int seed)
+{
+    Emitter *e = Emitter_New(bench_config(count, capacity, seed));
+    if (e)
+        Emitter_Burst(e);
+
+    return e;
+}
+
+// particles_bench times Emitter_Update and the scalar Emitter_UpdateReference over count
+// live particles, and runs both for a second of 60 Hz updates from the same start to find
+// the largest position difference
+int particles_bench(size_t count, int steps, ParticleBench *result)
+{
+    Emitter *e = bench_emitter(count, count, 1);
+    Emitter *reference = bench_emitter(count, count, 1);
+    if (!e || !reference)
+    {
+        if (e)
+            Emitter_Free(e);
+        if (reference)
+            Emitter_Free(reference);
+        return -1;
+    }
+
+    result->max_error = 0.0;
+    for (int i = 0; i < 60; i++)
+    {
+        Emitter_Update(e, 1.0f / 60.0f);
+        Emitter_UpdateReference(reference, 1.0f / 60.0f);
+    }
+    // both remove the same particles in the same order, unless they disagree on which died
+    if (e->count != reference->count)
+        result->max_error = INFINITY;
+    for (size_t i = 0; i < e->count && i < reference->count; i++)
+    {
+        double error = fmax(fabs(e->positionX[i] - reference->positionX[i]), fabs(e->positionY[i] - reference->positionY[i]));
+        if (error > result->max_error)
+            result->max_error = error;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < steps; i++)
+        Emitter_Update(e, 1.0f / 60.0f);
+    result->update_seconds = (now_seconds() - start) / steps;
+
+    start = now_seconds();
+    for (int i = 0; i < steps; i++)
+        Emitter_UpdateReference(reference, 1.0f / 60.0f);
+    result->reference_seconds = (now_seconds() - start) / steps;
+
+    Emitter_Free(e);
+    Emitter_Free(reference);
+
+    return 0;
+}
+
+// particles_bench_occupancy returns the mean seconds one Emitter_Update takes for an
+// emitter with room for capacity particles of which live are flying
+double particles_bench_occupancy(size_t capacity, size_t live, int steps)
+{
+    Emitter *e = bench_emitter(live, capacity, 1);
+    if (!e)
+        return -1.0;
+
+    double start = now_seconds();
+    for (int i = 0; i < steps; i++)
+        Emitter_Update(e, 1.0f / 60.0f);
+    double elapsed = now_seconds() - start;
+
+    Emitter_Free(e);
+
+    return elapsed / steps;
+}
+
+// particles_bench_spawn returns the particles Emitter_Burst inits per second, bursting
+// count into an empty emitter rounds times. The particles are cleared between bursts
+// by one long update, outside the timing.
+double particles_bench_spawn(size_t count, int rounds)
+{
+    Emitter *e = bench_emitter(0, count, 1);
+    if (!e)
+        return -1.0;
+    e->config.burst = (IntRange){ (int)count, (int)count };
+
+    double elapsed = 0.0;
+    for (int i = 0; i < rounds; i++)
+    {
+        double start = now_seconds();
+        Emitter_Burst(e);
+        elapsed += now_seconds() - start;
+        Emitter_Update(e, 1e6f);
+    }
+
+    Emitter_Free(e);
+
+    return (double)count * rounds / elapsed;
+}
+
+// particles_bench_quads returns the mean seconds Emitter_Draw takes to write the quads
+// of count live particles to its vertex buffers, without drawing them
+double particles_bench_quads(size_t count, int steps)
+{
+    Emitter *e = bench_emitter(count, count, 1);
+    float *vertices = malloc(count * 12 * sizeof(float));
+    unsigned char *colors = malloc(count * 16);
+    double elapsed = -1.0;
+
+    if (e && vertices && colors)
+    {
+        e->config.texture = (Texture2D){ .width = 16, .height = 16 };
+        e->config.endColor = (Color){ 0, 0, 0, 0 };
+
+        double start = now_seconds();
+        for (int i = 0; i < steps; i++)
+            Emitter_BuildQuads(e, 0, count, vertices, colors);
+        elapsed = (now_seconds() - start) / steps;
+    }
+
+    free(vertices);
+    free(colors);
+    if (e)
+        Emitter_Free(e);
+
+    return elapsed;
+}
+
+// color_error is the largest channel difference of two colors
+static int color_error(Color a, Color b)
+{
+    int channels[4] = { abs(a.r - b.r), abs(a.g - b.g), abs(a.b - b.b), abs(a.a - b.a) };
+    int error = 0;
+    for (int c = 0; c < 4; c++)
+        if (channels[c] > error)
+            error = channels[c];
+
+    return error;
+}
+
+// ramp_errors sweeps the life of particles of e and finds how far the colors and sizes
+// of its ramps get from evaluating its config exactly, and the largest steps between
+// neighbouring colors and sizes, half of which a nearest entry lookup may be off by
+static void ramp_errors(const Emitter *e, int *color, double *size, int *step, double *size_step)
+{
+    *color = 0;
+    *size = 0.0;
+    *step = 0;
+    *size_step = 0.0;
+    for (int k = 1; k < EMITTER_RAMP_SIZE; k++)
+    {
+        int error = color_error(e->colorRamp[k - 1], e->colorRamp[k]);
+        if (error > *step)
+            *step = error;
+        double size = fabs(e->sizeRamp[k] - e->sizeRamp[k - 1]);
+        if (size > *size_step)
+            *size_step = size;
+    }
+    for (int i = 0; i <= 100000; i++)
+    {
+        float fraction = i / 100000.0f;
+        int k = (int)(fraction * (EMITTER_RAMP_SIZE - 1) + 0.5f);
+
+        int error = color_error(e->colorRamp[k], Emitter_RampColor(&e->config, fraction));
+        if (error > *color)
+            *color = error;
+        double size_error = fabs(e->sizeRamp[k] - Emitter_RampSize(&e->config, fraction));
+        if (size_error > *size)
+            *size = size_error;
+    }
+}
+
+// particles_bench_colors times the color lookups of count particles spread over their
+// lives against computing them with LinearFade, and finds how far the ramps of a plain
+// start to end fade and of a gradient with several color, alpha and size stops get
+// from the colors and sizes they were baked from
+int particles_bench_colors(size_t count, int steps, ParticleColorBench *result)
+{
+    EmitterConfig cfg = bench_config(count, count, 1);
+    cfg.startColor = (Color){ 190, 33, 55, 255 };
+    cfg.endColor = (Color){ 20, 240, 55, 0 };
+
+    Emitter *e = Emitter_New(cfg);
+    Color *colors = malloc(count * sizeof(Color));
+    if (!e || !colors)
+    {
+        if (e)
+            Emitter_Free(e);
+        free(colors);
+        return -1;
+    }
+
+    Emitter_Burst(e);
+    for (size_t i = 0; i < e->count; i++)
+        e->age[i] = e->ttl[i] * (float)(i % 1000) / 1000.0f;
+
+    // volatile keeps the passes from being dropped
+    volatile unsigned char sink = 0;
+    double start = now_seconds();
+    for (int s = 0; s < steps; s++)
+    {
+        for (size_t i = 0; i < e->count; i++)
+            colors[i] = e->colorRamp[Emitter_RampIndex(e, i)];
+        sink ^= colors[s % e->count].r;
+    }
+    result->ramp_seconds = (now_seconds() - start) / steps;
+
+    start = now_seconds();
+    for (int s = 0; s < steps; s++)
+    {
+        for (size_t i = 0; i < e->count; i++)
+            colors[i] = LinearFade(cfg.startColor, cfg.endColor, e->age[i] / e->ttl[i]);
+        sink ^= colors[s % e->count].r;
+    }
+    result->fade_seconds = (now_seconds() - start) / steps;
+    (void)sink;
+
+    double size_error, size_step;
+    int step;
+    ramp_errors(e, &result->fade_error, &size_error, &step, &size_step);
+
+    // white hot to red to smoke, fading in and out and swelling
+    cfg.colorStops[0] = (ColorStop){ 0.0f, (Color){ 255, 255, 255, 255 } };
+    cfg.colorStops[1] = (ColorStop){ 0.15f, (Color){ 255, 200, 60, 255 } };
+    cfg.colorStops[2] = (ColorStop){ 0.5f, (Color){ 190, 33, 55, 255 } };
+    cfg.colorStops[3] = (ColorStop){ 1.0f, (Color){ 60, 60, 60, 255 } };
+    cfg.colorStopCount = 4;
+    cfg.alphaStops[0] = (FloatStop){ 0.0f, 0.0f };
+    cfg.alphaStops[1] = (FloatStop){ 0.05f, 1.0f };
+    cfg.alphaStops[2] = (FloatStop){ 0.7f, 0.8f };
+    cfg.alphaStops[3] = (FloatStop){ 1.0f, 0.0f };
+    cfg.alphaStopCount = 4;
+    cfg.sizeStops[0] = (FloatStop){ 0.0f, 0.5f };
+    cfg.sizeStops[1] = (FloatStop){ 0.3f, 1.5f };
+    cfg.sizeStops[2] = (FloatStop){ 1.0f, 3.0f };
+    cfg.sizeStopCount = 3;
+
+    int ret = Emitter_Reinit(e, cfg) ? 0 : -1;
+    if (ret == 0)
+        ramp_errors(e, &result->gradient_error, &result->size_error, &result->gradient_step, &result->size_step);
+
+    Emitter_Free(e);
+    free(colors);
+
+    return ret;
+}
+
+// states_equal compares everything Emitter_Draw reads of two emitters bit for bit
+static bool states_equal(const Emitter *a, const Emitter *b)
+{
+    if (a->count != b->count)
+        return false;
+
+    const float *arrays[][2] = {
+        { a->positionX, b->positionX }, { a->positionY, b->positionY },
+        { a->age, b->age }, { a->ttl, b->ttl },
+    };
+    for (int i = 0; i < (int)(sizeof(arrays) / sizeof(arrays[0])); i++)
+        if (memcmp(arrays[i][0], arrays[i][1], a->count * sizeof(float)) != 0)
+            return false;
+
+    return true;
+}
+
+// particles_bench_threads updates a system of PARTICLES_BENCH_EMITTERS emitters of unequal
+// sizes and count particles in all, with particles dying and emitted every update, on a
+// JobPool of threads threads. For 120 updates it compares the state a draw would read
+// after every update with the one of the same system updated on this thread, then times
+// steps more updates.
+int particles_bench_threads(size_t count, int threads, int steps, ParticleThreadsBench *result)
+{
+    // shares of count, the largest emitter is split into many chunks
+    static const double shares[PARTICLES_BENCH_EMITTERS] = { 0.5, 0.25, 0.15, 0.1 };
+
+    JobPool pool;
+    if (job_pool_init(&pool, threads) != 0)
+        return -1;
+
+    ParticleSystem *systems[2] = { ParticleSystem_New(), ParticleSystem_New() };
+    Emitter *emitters[2][PARTICLES_BENCH_EMITTERS] = { { NULL } };
+    int ret = systems[0] && systems[1] ? 0 : -1;
+    for (int s = 0; s < 2 && ret == 0; s++)
+    {
+        for (int i = 0; i < PARTICLES_BENCH_EMITTERS && ret == 0; i++)
+        {
+            size_t live = (size_t)(count * shares[i]);
+            EmitterConfig cfg = bench_config(live, live, (unsigned int)i + 1);
+            // particles live one to two seconds and are replaced as they die
+            cfg.age = (FloatRange){ 1.0f, 2.0f };
+            cfg.emissionRate = live;
+
+            emitters[s][i] = Emitter_New(cfg);
+            if (!emitters[s][i] || !ParticleSystem_Register(systems[s], emitters[s][i]))
+            {
+                ret = -1;
+                break;
+            }
+            Emitter_Burst(emitters[s][i]);
+            Emitter_Start(emitters[s][i]);
+        }
+    }
+
+    if (ret == 0)
+    {
+        ParticleSystem_SetRunner(systems[0], run_jobs, &pool);
+
+        result->identical = true;
+        for (int i = 0; i < 120; i++)
+        {
+            ParticleSystem_Update(systems[0], 1.0f / 60.0f);
+            ParticleSystem_Update(systems[1], 1.0f / 60.0f);
+            for (int e = 0; e < PARTICLES_BENCH_EMITTERS; e++)
+                result->identical = result->identical && states_equal(emitters[0][e], emitters[1][e]);
+        }
+
+        long steals = job_pool_steals(&pool);
+        double start = now_seconds();
+        for (int i = 0; i < steps; i++)
+            ParticleSystem_Update(systems[0], 1.0f / 60.0f);
+        result->update_seconds = (now_seconds() - start) / steps;
+        result->steals_per_update = (double)(job_pool_steals(&pool) - steals) / steps;
+    }
+
+    for (int s = 0; s < 2; s++)
+    {
+        for (int i = 0; i < PARTICLES_BENCH_EMITTERS; i++)
+            if (emitters[s][i])
+                Emitter_Free(emitters[s][i]);
+        if (systems[s])
+            ParticleSystem_Free(systems[s]);
+    }
+    job_pool_free(&pool);
+
+    return ret;
+}
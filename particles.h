@@ -0,0 +1,67 @@
+#pragma once
+
+#include "beats.h"
+#include "jobs.h"
+
+#include "raylib.h"
+
+// partikel.h always carries its implementation, so it is only included by particles.c
+struct ParticleSystem;
+struct Emitter;
+
+// BeatParticles bursts particles from the waveform on every beat and onset
+typedef struct BeatParticles
+{
+    struct ParticleSystem *system;
+    struct Emitter *beat;
+    struct Emitter *onset;
+    Texture2D texture;
+    JobPool jobs;
+    bool threaded; // updated on jobs
+} BeatParticles;
+
+int beat_particles_init(BeatParticles *bp, Vector2 origin, int threads);
+void beat_particles_fire(BeatParticles *bp, const BeatEvent *event);
+unsigned long beat_particles_update(BeatParticles *bp, float dt);
+void beat_particles_draw(BeatParticles *bp);
+void beat_particles_free(BeatParticles *bp);
+
+// ParticleBench is what particles_bench measured
+typedef struct ParticleBench
+{
+    double update_seconds; // per Emitter_Update
+    double reference_seconds; // per scalar update
+    double max_error; // largest position difference in pixels after a second
+} ParticleBench;
+
+int particles_bench(size_t count, int steps, ParticleBench *result);
+double particles_bench_occupancy(size_t capacity, size_t live, int steps);
+double particles_bench_spawn(size_t count, int rounds);
+double particles_bench_quads(size_t count, int steps);
+
+// ParticleColorBench is what particles_bench_colors measured
+typedef struct ParticleColorBench
+{
+    double ramp_seconds; // per pass of color lookups
+    double fade_seconds; // per pass of LinearFade
+    int fade_error; // largest channel difference of the start to end ramp from LinearFade
+    int gradient_error; // largest channel difference of the gradient ramp from its stops
+    int gradient_step; // largest channel difference between neighbouring entries of the gradient ramp
+    double size_error; // largest scale difference of the size ramp from its stops
+    double size_step; // largest scale difference between neighbouring entries of the size ramp
+} ParticleColorBench;
+
+int particles_bench_colors(size_t count, int steps, ParticleColorBench *result);
+
+// emitters of the particles_bench_threads system
+#define PARTICLES_BENCH_EMITTERS 4
+
+// ParticleThreadsBench is what particles_bench_threads measured
+typedef struct ParticleThreadsBench
+{
+    double update_seconds; // per ParticleSystem_Update
+    double steals_per_update;
+    bool identical; // every update matched the one on a single thread
+} ParticleThreadsBench;
+
+int particles_bench_threads(size_t count, int threads, int steps, ParticleThreadsBench *result);
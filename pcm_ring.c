@@ -0,0 +1,90 @@
+#include "pcm_ring.h"
+
+void pcm_ring_init(PcmRing *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->finished = false;
+    ring->closed = false;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->not_full, NULL);
+}
+
+void pcm_ring_destroy(PcmRing *ring)
+{
+    pthread_cond_destroy(&ring->not_full);
+    pthread_mutex_destroy(&ring->lock);
+}
+
+// returns the next free chunk, waiting for the consumer if the ring is full.
+// returns NULL once the consumer has closed the ring.
+PcmChunk *pcm_ring_acquire(PcmRing *ring)
+{
+    PcmChunk *chunk = NULL;
+
+    pthread_mutex_lock(&ring->lock);
+    while (!ring->closed && ring->head - ring->tail >= PCM_RING_CHUNKS)
+        pthread_cond_wait(&ring->not_full, &ring->lock);
+    if (!ring->closed)
+    {
+        chunk = &ring->chunks[ring->head % PCM_RING_CHUNKS];
+        chunk->frames = 0;
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    return chunk;
+}
+
+// publishes the chunk returned by the last pcm_ring_acquire
+void pcm_ring_commit(PcmRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->head++;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+void pcm_ring_finish(PcmRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->finished = true;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// returns the oldest committed chunk or NULL if nothing is ready yet
+const PcmChunk *pcm_ring_peek(PcmRing *ring)
+{
+    const PcmChunk *chunk = NULL;
+
+    pthread_mutex_lock(&ring->lock);
+    if (ring->tail != ring->head)
+        chunk = &ring->chunks[ring->tail % PCM_RING_CHUNKS];
+    pthread_mutex_unlock(&ring->lock);
+
+    return chunk;
+}
+
+void pcm_ring_release(PcmRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->tail++;
+    pthread_cond_signal(&ring->not_full);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// true once the producer finished and every chunk has been consumed
+bool pcm_ring_done(PcmRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    bool done = ring->finished && ring->tail == ring->head;
+    pthread_mutex_unlock(&ring->lock);
+
+    return done;
+}
+
+void pcm_ring_close(PcmRing *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    ring->closed = true;
+    pthread_cond_broadcast(&ring->not_full);
+    pthread_mutex_unlock(&ring->lock);
+}
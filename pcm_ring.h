@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// number of sample frames carried by one chunk
+#define PCM_CHUNK_FRAMES 4096
+// number of chunks the decoder may run ahead of the consumer
+#define PCM_RING_CHUNKS 64
+// decoded audio is downmixed to at most stereo
+#define PCM_MAX_CHANNELS 2
+
+typedef struct PcmChunk
+{
+    int frames;
+    unsigned char samples[PCM_CHUNK_FRAMES * PCM_MAX_CHANNELS * sizeof(float)]; // interleaved, any SampleFormat
+} PcmChunk;
+
+// PcmRing is a bounded queue of fixed size chunks handed from the decode thread
+// to the render loop. The producer blocks while the ring is full, the consumer never blocks.
+typedef struct PcmRing
+{
+    PcmChunk chunks[PCM_RING_CHUNKS];
+    size_t head; // next chunk to be written
+    size_t tail; // next chunk to be read
+    bool finished; // producer reached the end of the stream
+    bool closed; // consumer is gone, producer should stop
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+} PcmRing;
+
+void pcm_ring_init(PcmRing *ring);
+void pcm_ring_destroy(PcmRing *ring);
+
+// producer side
+PcmChunk *pcm_ring_acquire(PcmRing *ring);
+void pcm_ring_commit(PcmRing *ring);
+void pcm_ring_finish(PcmRing *ring);
+
+// consumer side
+const PcmChunk *pcm_ring_peek(PcmRing *ring);
+void pcm_ring_release(PcmRing *ring);
+bool pcm_ring_done(PcmRing *ring);
+void pcm_ring_close(PcmRing *ring);
@@ -0,0 +1,193 @@
+#include "peaks.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline PeakBlock block_merge(PeakBlock a, PeakBlock b)
+{
+    return (PeakBlock){
+        .min = a.min < b.min ? a.min : b.min,
+        .max = a.max > b.max ? a.max : b.max,
+        .sum2 = a.sum2 + b.sum2
+    };
+}
+
+static const PeakBlock block_empty = { .min = 1e30f, .max = -1e30f, .sum2 = 0.0f };
+
+static int level_push(PeakLevel *level, PeakBlock block)
+{
+    if (level->count == level->capacity)
+    {
+        int capacity = level->capacity ? level->capacity * 2 : 256;
+        PeakBlock *blocks = (PeakBlock *)realloc(level->blocks, capacity * sizeof(PeakBlock));
+        if (!blocks)
+            return -1;
+        level->blocks = blocks;
+        level->capacity = capacity;
+    }
+    level->blocks[level->count++] = block;
+
+    return 0;
+}
+
+// peaks_init prepares an empty pyramid, sized up front when the track length is known
+void peaks_init(Peaks *peaks, int expected_frames)
+{
+    memset(peaks, 0, sizeof(*peaks));
+    peaks->pending = block_empty;
+
+    int blocks = expected_frames / PEAKS_BASE + 1;
+    for (int l = 0; l < PEAKS_MAX_LEVELS && blocks > 1; l++, blocks /= 2)
+    {
+        peaks->levels[l].blocks = (PeakBlock *)malloc(blocks * sizeof(PeakBlock));
+        peaks->levels[l].capacity = peaks->levels[l].blocks ? blocks : 0;
+    }
+}
+
+// appends a finished level 0 block and merges every pair completed by it into the level above
+static int peaks_push(Peaks *peaks, PeakBlock block)
+{
+    for (int l = 0; l < PEAKS_MAX_LEVELS; l++)
+    {
+        PeakLevel *level = &peaks->levels[l];
+        if (level_push(level, block) != 0)
+            return -1;
+        if (l + 1 > peaks->level_count)
+            peaks->level_count = l + 1;
+        if (level->count % 2 != 0)
+            break;
+        block = block_merge(level->blocks[level->count - 2], level->blocks[level->count - 1]);
+    }
+
+    return 0;
+}
+
+// peaks_update summarizes up to max_frames frames appended to the track since the last call,
+// so a long track that is already complete is spread over several render frames.
+// returns the number of frames consumed.
+int peaks_update(Peaks *peaks, const Track *track, int max_frames)
+{
+    int end = track->size;
+    if (end - peaks->frames > max_frames)
+        end = peaks->frames + max_frames;
+
+    int start = peaks->frames;
+    for (int i = start; i < end; i++)
+    {
+        float s = track_mono(track, i);
+        PeakBlock *b = &peaks->pending;
+        if (s < b->min)
+            b->min = s;
+        if (s > b->max)
+            b->max = s;
+        b->sum2 += s * s;
+
+        if (++peaks->pending_frames == PEAKS_BASE)
+        {
+            if (peaks_push(peaks, *b) != 0)
+            {
+                end = i + 1;
+                break;
+            }
+            *b = block_empty;
+            peaks->pending_frames = 0;
+        }
+    }
+    peaks->frames = end;
+
+    return end - start;
+}
+
+// merges everything in [a, b) using the blocks of the given level, going down a level
+// for the tail the level doesn't cover yet and to raw samples below level 0.
+// spans past the consumed frames are estimated from strided samples.
+static PeakBlock peaks_span(const Peaks *peaks, const Track *track, int level, long a, long b, long *frames)
+{
+    PeakBlock acc = block_empty;
+    *frames = 0;
+
+    for (; level >= 0; level--)
+    {
+        const PeakLevel *lv = &peaks->levels[level];
+        long size = (long)PEAKS_BASE << level;
+        long covered = lv->count * size;
+        if (a < covered)
+        {
+            long first = a / size;
+            long last = (b + size - 1) / size;
+            if (last > lv->count)
+                last = lv->count;
+            for (long k = first; k < last; k++)
+                acc = block_merge(acc, lv->blocks[k]);
+            *frames += (last - first) * size;
+            a = covered;
+        }
+        if (a >= b)
+            return acc;
+    }
+
+    // frames of the block peaks_update is filling
+    long pending = b < peaks->frames ? b : peaks->frames;
+    for (; a < pending; a++)
+    {
+        float s = track_mono(track, (int)a);
+        acc = block_merge(acc, (PeakBlock){ s, s, s * s });
+        (*frames)++;
+    }
+
+    // frames peaks_update hasn't reached, which is most of a long track that arrived
+    // complete, are sampled at a stride so a column never reads more than PEAKS_RAW_SAMPLES
+    long end = b < track->size ? b : track->size;
+    if (a < end)
+    {
+        long stride = (end - a + PEAKS_RAW_SAMPLES - 1) / PEAKS_RAW_SAMPLES;
+        for (long i = a; i < end; i += stride)
+        {
+            float s = track_mono(track, (int)i);
+            long n = end - i < stride ? end - i : stride;
+            acc = block_merge(acc, (PeakBlock){ s, s, s * s * n });
+        }
+        *frames += end - a;
+    }
+
+    return acc;
+}
+
+// peaks_query fills width columns starting at frame start, each summarizing frames_per_column frames.
+// every column merges a bounded number of blocks, so the cost is O(width) whatever the span.
+void peaks_query(const Peaks *peaks, const Track *track, double start, double frames_per_column, int width, PeakColumn *out)
+{
+    // the coarsest level whose blocks still fit in a column
+    int level = -1;
+    while (level + 1 < peaks->level_count && ((double)((long)PEAKS_BASE << (level + 1))) <= frames_per_column)
+        level++;
+
+    for (int x = 0; x < width; x++)
+    {
+        long a = (long)(start + x * frames_per_column);
+        long b = (long)(start + (x + 1) * frames_per_column);
+        if (b <= a)
+            b = a + 1;
+        if (a < 0)
+            a = 0;
+        if (b > track->size)
+            b = track->size;
+
+        long frames = 0;
+        PeakBlock block = a < b ? peaks_span(peaks, track, level, a, b, &frames) : block_empty;
+        if (frames == 0)
+        {
+            out[x] = (PeakColumn){ 0.0f, 0.0f, 0.0f };
+            continue;
+        }
+        out[x] = (PeakColumn){ block.min, block.max, sqrtf(block.sum2 / frames) };
+    }
+}
+
+void peaks_free(Peaks *peaks)
+{
+    for (int l = 0; l < PEAKS_MAX_LEVELS; l++)
+        free(peaks->levels[l].blocks);
+    memset(peaks, 0, sizeof(*peaks));
+}
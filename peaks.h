@@ -0,0 +1,49 @@
+#pragma once
+
+#include "track.h"
+
+// frames summarized by one block of the finest level
+#define PEAKS_BASE 64
+#define PEAKS_MAX_LEVELS 32
+// most samples read for the part of a column the pyramid doesn't cover yet
+#define PEAKS_RAW_SAMPLES 64
+
+// PeakBlock summarizes a run of mono samples
+typedef struct PeakBlock
+{
+    float min;
+    float max;
+    float sum2; // sum of squares, for RMS
+} PeakBlock;
+
+typedef struct PeakLevel
+{
+    PeakBlock *blocks;
+    int count;
+    int capacity;
+} PeakLevel;
+
+// Peaks is a min/max/RMS pyramid of a track. Level 0 summarizes PEAKS_BASE frames
+// per block and every level above halves the resolution of the one below.
+// It is built incrementally as frames are appended to the track.
+typedef struct Peaks
+{
+    PeakLevel levels[PEAKS_MAX_LEVELS];
+    int level_count;
+    int frames; // frames of the track consumed so far
+    PeakBlock pending; // level 0 block being accumulated
+    int pending_frames;
+} Peaks;
+
+// PeakColumn is the summary of the frames under one pixel column
+typedef struct PeakColumn
+{
+    float min;
+    float max;
+    float rms;
+} PeakColumn;
+
+void peaks_init(Peaks *peaks, int expected_frames);
+int peaks_update(Peaks *peaks, const Track *track, int max_frames);
+void peaks_query(const Peaks *peaks, const Track *track, double start, double frames_per_column, int width, PeakColumn *out);
+void peaks_free(Peaks *peaks);
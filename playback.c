@@ -0,0 +1,223 @@
+#include "playback.h"
+#include "profile.h"
+#include "timing.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+int playback_init(Playback *pb, int sample_rate, int channels, SampleFormat format)
+{
+    // the device reads the track's samples as they are stored, 32 bit means float to raylib
+    SetAudioStreamBufferSizeDefault(PLAYBACK_BUFFER_FRAMES);
+    pb->stream = LoadAudioStream(sample_rate, sample_format_size(format) * 8, channels);
+    if (pb->stream.buffer == NULL)
+        return -1;
+
+    pthread_mutex_init(&pb->lock, NULL);
+    pb->threaded = false;
+    pb->track = NULL;
+
+    pb->tap = malloc(sizeof(AudioTap));
+    pb->tap_block = malloc(sizeof(float) * PLAYBACK_BUFFER_FRAMES);
+    if (!pb->tap || !pb->tap_block)
+    {
+        playback_free(pb);
+        return -1;
+    }
+    audio_tap_init(pb->tap);
+    pb->tap_offset = 0.0;
+
+    pb->cursor = 0;
+    pb->paused = false;
+    pb->primed = false;
+    pb->underruns = 0;
+    pb->synced_frame = 0.0;
+    pb->synced_time = now_seconds();
+    PlayAudioStream(pb->stream);
+
+    return 0;
+}
+
+// refill sends every processed device buffer the next block of the track, with lock held.
+// Nothing is sent until a full buffer has been decoded, unless the track is complete.
+static void refill(Playback *pb, const Track *track)
+{
+    int refilled = 0;
+    while (!pb->paused && IsAudioStreamProcessed(pb->stream))
+    {
+        int frames = track->size - pb->cursor;
+        if (frames > PLAYBACK_BUFFER_FRAMES)
+            frames = PLAYBACK_BUFFER_FRAMES;
+        if (frames <= 0 || (frames < PLAYBACK_BUFFER_FRAMES && !track->complete))
+            break;
+
+        // both buffers processed means the device played them out and is
+        // waiting on silence, except for the first fill after a restart
+        if (++refilled == 2 && pb->primed)
+            pb->underruns++;
+
+        UpdateAudioStream(pb->stream, track_frame(track, pb->cursor), frames);
+
+        // the same frames go to the tap for the visualization
+        for (int i = 0; i < frames; i++)
+            pb->tap_block[i] = track_mono(track, pb->cursor + i);
+        audio_tap_push(pb->tap, pb->tap_block, frames);
+
+        pb->cursor += frames;
+        pb->tap_offset = (double)audio_tap_written(pb->tap) - pb->cursor;
+
+        // a buffer is requested when the device starts playing the other one,
+        // so two buffers are queued right after the refill
+        pb->synced_frame = pb->cursor - 2 * PLAYBACK_BUFFER_FRAMES;
+        if (pb->synced_frame < 0)
+            pb->synced_frame = 0;
+        pb->synced_time = now_seconds();
+    }
+    if (refilled > 0)
+        pb->primed = true;
+}
+
+static void *playback_thread(void *arg)
+{
+    Playback *pb = arg;
+    const struct timespec poll = { 0, PLAYBACK_POLL_MS * 1000000L };
+
+    while (!atomic_load(&pb->stop))
+    {
+        double start = profile_begin();
+        pthread_mutex_lock(&pb->lock);
+        refill(pb, pb->track);
+        pthread_mutex_unlock(&pb->lock);
+        profile_end(PROFILE_AUDIO, start);
+        nanosleep(&poll, NULL);
+    }
+
+    return NULL;
+}
+
+// playback_start moves the refills to a thread of their own, at real time priority when
+// the system allows it. The track must then only be appended to with the playback locked.
+int playback_start(Playback *pb, const Track *track)
+{
+    pb->track = track;
+    atomic_store(&pb->stop, false);
+    if (pthread_create(&pb->thread, NULL, playback_thread, pb) != 0)
+        return -1;
+    pb->threaded = true;
+
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_FIFO) };
+    if (pthread_setschedparam(pb->thread, SCHED_FIFO, &param) != 0)
+        TraceLog(LOG_INFO, "MUSICVIZ: Audio thread runs at normal priority");
+
+    return 0;
+}
+
+void playback_lock(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+}
+
+void playback_unlock(Playback *pb)
+{
+    pthread_mutex_unlock(&pb->lock);
+}
+
+// playback_update refills the device buffer from the track, like UpdateMusicStream does for Music.
+// Only needed when the refill thread isn't running.
+void playback_update(Playback *pb, const Track *track)
+{
+    pthread_mutex_lock(&pb->lock);
+    refill(pb, track);
+    pthread_mutex_unlock(&pb->lock);
+}
+
+void playback_restart(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    StopAudioStream(pb->stream);
+    pb->cursor = 0;
+    pb->primed = false;
+    pb->synced_frame = 0.0;
+    pb->synced_time = now_seconds();
+    pb->tap_offset = (double)audio_tap_written(pb->tap);
+    if (!pb->paused)
+        PlayAudioStream(pb->stream);
+    pthread_mutex_unlock(&pb->lock);
+}
+
+// heard_frame estimates the frame currently heard, interpolated with the wall clock
+// between device refills and never ahead of what has been sent. Called with lock held.
+static double heard_frame(const Playback *pb)
+{
+    if (pb->paused)
+        return pb->synced_frame;
+
+    double frame = pb->synced_frame + (now_seconds() - pb->synced_time) * pb->stream.sampleRate;
+    if (frame > pb->cursor)
+        frame = pb->cursor;
+
+    return frame;
+}
+
+void playback_pause(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    pb->synced_frame = heard_frame(pb);
+    pb->paused = true;
+    PauseAudioStream(pb->stream);
+    pthread_mutex_unlock(&pb->lock);
+}
+
+void playback_resume(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    pb->paused = false;
+    pb->synced_time = now_seconds();
+    ResumeAudioStream(pb->stream);
+    pthread_mutex_unlock(&pb->lock);
+}
+
+double playback_frame(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    double frame = heard_frame(pb);
+    pthread_mutex_unlock(&pb->lock);
+
+    return frame;
+}
+
+// playback_tap_position is the tap position of the frame currently heard
+uint64_t playback_tap_position(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    uint64_t position = (uint64_t)(heard_frame(pb) + pb->tap_offset);
+    pthread_mutex_unlock(&pb->lock);
+
+    return position;
+}
+
+long playback_underruns(Playback *pb)
+{
+    pthread_mutex_lock(&pb->lock);
+    long underruns = pb->underruns;
+    pthread_mutex_unlock(&pb->lock);
+
+    return underruns;
+}
+
+void playback_free(Playback *pb)
+{
+    if (pb->threaded)
+    {
+        atomic_store(&pb->stop, true);
+        pthread_join(pb->thread, NULL);
+        pb->threaded = false;
+    }
+
+    UnloadAudioStream(pb->stream);
+    pthread_mutex_destroy(&pb->lock);
+    free(pb->tap);
+    free(pb->tap_block);
+    pb->tap = NULL;
+    pb->tap_block = NULL;
+}
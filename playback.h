@@ -0,0 +1,51 @@
+#pragma once
+
+#include "tap.h"
+#include "track.h"
+
+#include "raylib.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// frames sent to the audio device per UpdateAudioStream call
+#define PLAYBACK_BUFFER_FRAMES 4096
+// how often the audio thread checks for a processed device buffer
+#define PLAYBACK_POLL_MS 4
+
+// Playback streams a Track to the audio device, replacing raylib's own
+// music decoder so the file is only decoded once. Once started, the device
+// buffers are refilled from a thread of their own so a slow frame can't starve
+// the device; the state below is then guarded by lock.
+typedef struct Playback
+{
+    AudioStream stream;
+    int cursor; // next frame to be sent to the device
+    bool paused;
+    bool primed; // both device buffers were filled since the last restart
+    double synced_frame; // frame being heard at synced_time
+    double synced_time;
+    long underruns; // times the device ran out of queued samples
+    AudioTap *tap; // every frame sent to the device, downmixed to mono
+    float *tap_block;
+    double tap_offset; // tap position of frame 0 of the track since the last restart
+    pthread_mutex_t lock;
+    pthread_t thread;
+    const Track *track;
+    bool threaded;
+    _Atomic bool stop;
+} Playback;
+
+int playback_init(Playback *pb, int sample_rate, int channels, SampleFormat format);
+int playback_start(Playback *pb, const Track *track);
+void playback_lock(Playback *pb);
+void playback_unlock(Playback *pb);
+void playback_update(Playback *pb, const Track *track);
+void playback_restart(Playback *pb);
+void playback_pause(Playback *pb);
+void playback_resume(Playback *pb);
+double playback_frame(Playback *pb);
+uint64_t playback_tap_position(Playback *pb);
+long playback_underruns(Playback *pb);
+void playback_free(Playback *pb);
@@ -0,0 +1,200 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// overlay bars, pixels per millisecond and the longest bar
+#define PROFILE_BAR_SCALE 12.0
+#define PROFILE_BAR_WIDTH 200
+
+Profile profile;
+
+static const char *stage_names[PROFILE_STAGES] = {
+    "pacing", "audio", "analysis", "waveform", "particles", "draw", "swap",
+};
+
+// threads are numbered in the order they first record an event
+static _Atomic int thread_count;
+static _Thread_local int thread_id = -1;
+
+typedef struct ProfileSample
+{
+    int stage;
+    double ms;
+} ProfileSample;
+
+// summaries are only made by one thread, they sort in here
+static ProfileSample samples[PROFILE_CAPACITY];
+
+const char *profile_stage_name(ProfileStage stage)
+{
+    return stage_names[stage];
+}
+
+void profile_enable(bool enabled)
+{
+    if (enabled && profile.origin == 0.0)
+        profile.origin = now_seconds();
+    atomic_store(&profile.enabled, enabled);
+}
+
+void profile_record(ProfileStage stage, double start, double end)
+{
+    if (thread_id < 0)
+        thread_id = atomic_fetch_add(&thread_count, 1);
+
+    uint64_t position = atomic_fetch_add_explicit(&profile.head, 1, memory_order_relaxed);
+    ProfileEvent *event = &profile.events[position & (PROFILE_CAPACITY - 1)];
+
+    atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event->stage = stage;
+    event->thread = thread_id;
+    event->start = start;
+    event->end = end;
+    atomic_store_explicit(&event->seq, position + 1, memory_order_release);
+}
+
+// read_event copies the event at a ring position, false if it was overwritten or is
+// still being written
+static bool read_event(uint64_t position, ProfileEvent *out)
+{
+    const ProfileEvent *event = &profile.events[position & (PROFILE_CAPACITY - 1)];
+
+    uint64_t seq = atomic_load_explicit(&event->seq, memory_order_acquire);
+    if (seq != position + 1)
+        return false;
+
+    out->stage = event->stage;
+    out->thread = event->thread;
+    out->start = event->start;
+    out->end = event->end;
+
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&event->seq, memory_order_relaxed) == seq;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    const ProfileSample *x = a;
+    const ProfileSample *y = b;
+    if (x->stage != y->stage)
+        return x->stage - y->stage;
+    return (x->ms > y->ms) - (x->ms < y->ms);
+}
+
+// profile_summarize computes the p50 and p99 of every stage over the events of the last
+// PROFILE_WINDOW seconds still in the ring
+void profile_summarize(ProfileStats stats[PROFILE_STAGES])
+{
+    uint64_t head = atomic_load_explicit(&profile.head, memory_order_acquire);
+    uint64_t first = head > PROFILE_CAPACITY ? head - PROFILE_CAPACITY : 0;
+    double since = now_seconds() - PROFILE_WINDOW;
+
+    int count = 0;
+    for (uint64_t i = first; i < head; i++)
+    {
+        ProfileEvent event;
+        if (read_event(i, &event) && event.start >= since)
+            samples[count++] = (ProfileSample){ event.stage, (event.end - event.start) * 1000.0 };
+    }
+    qsort(samples, count, sizeof(ProfileSample), compare_samples);
+
+    memset(stats, 0, sizeof(ProfileStats) * PROFILE_STAGES);
+    for (int i = 0; i < count;)
+    {
+        int stage = samples[i].stage;
+        int n = 0;
+        while (i + n < count && samples[i + n].stage == stage)
+            n++;
+
+        // nearest rank percentiles
+        stats[stage].count = n;
+        stats[stage].p50_ms = samples[i + (n - 1) / 2].ms;
+        stats[stage].p99_ms = samples[i + (int)((n - 1) * 0.99 + 0.5)].ms;
+        i += n;
+    }
+}
+
+// profile_draw shows one row per stage with its p50 as a solid bar over a faint p99 bar
+void profile_draw(const DrawBackend *draw, const ProfileStats stats[PROFILE_STAGES], int x, int y)
+{
+    const int row = 14;
+    void *user = draw->user;
+
+    draw->rectangle(user, x, y, 380, row * PROFILE_STAGES + 8, (Color){ 0, 0, 0, 160 });
+    for (int s = 0; s < PROFILE_STAGES; s++)
+    {
+        int top = y + 4 + s * row;
+        int p50 = (int)(stats[s].p50_ms * PROFILE_BAR_SCALE + 0.5);
+        int p99 = (int)(stats[s].p99_ms * PROFILE_BAR_SCALE + 0.5);
+        if (p50 > PROFILE_BAR_WIDTH)
+            p50 = PROFILE_BAR_WIDTH;
+        if (p99 > PROFILE_BAR_WIDTH)
+            p99 = PROFILE_BAR_WIDTH;
+
+        draw->text(user, stage_names[s], x + 6, top + 2, 10, RAYWHITE);
+        draw->rectangle(user, x + 70, top + 2, p99, row - 4, (Color){ 255, 161, 0, 110 });
+        draw->rectangle(user, x + 70, top + 2, p50, row - 4, (Color){ 255, 161, 0, 255 });
+
+        char label[32];
+        snprintf(label, sizeof(label), "%.2f / %.2f ms", stats[s].p50_ms, stats[s].p99_ms);
+        draw->text(user, label, x + 78 + PROFILE_BAR_WIDTH, top + 2, 10, RAYWHITE);
+    }
+}
+
+// profile_export writes the events still in the ring as Chrome trace events, or as CSV
+// when path ends in .csv
+int profile_export(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+
+    const char *extension = strrchr(path, '.');
+    bool csv = extension && strcmp(extension, ".csv") == 0;
+
+    uint64_t head = atomic_load_explicit(&profile.head, memory_order_acquire);
+    uint64_t first = head > PROFILE_CAPACITY ? head - PROFILE_CAPACITY : 0;
+
+    if (csv)
+        fprintf(file, "stage,thread,start_us,duration_us\n");
+    else
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    int written = 0;
+    for (uint64_t i = first; i < head; i++)
+    {
+        ProfileEvent event;
+        if (!read_event(i, &event))
+            continue;
+
+        double start = (event.start - profile.origin) * 1e6;
+        double duration = (event.end - event.start) * 1e6;
+        if (csv)
+        {
+            fprintf(file, "%s,%d,%.3f,%.3f\n", stage_names[event.stage], event.thread, start, duration);
+        }
+        else
+        {
+            fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                written > 0 ? ",\n" : "", stage_names[event.stage], event.thread, start, duration);
+        }
+        written++;
+    }
+
+    if (!csv)
+        fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0)
+    {
+        fprintf(stderr, "Could not write %s\n", path);
+        return -1;
+    }
+
+    return written;
+}
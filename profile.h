@@ -0,0 +1,91 @@
+#pragma once
+
+#include "draw.h"
+#include "timing.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// timed events kept by the profiler, a power of two
+#define PROFILE_CAPACITY (1 << 14)
+// seconds of events summarized by the overlay
+#define PROFILE_WINDOW 2.0
+
+// ProfileStage names the part of a frame a timer covers
+typedef enum ProfileStage
+{
+    PROFILE_PACING, // sleeping until the frame is due
+    PROFILE_AUDIO, // moving decoded audio to the track and refilling the device
+    PROFILE_ANALYSIS, // peaks, beats and the spectrum
+    PROFILE_WAVEFORM, // generating the waveform points or envelope
+    PROFILE_PARTICLES,
+    PROFILE_DRAW, // submitting the draw calls
+    PROFILE_SWAP, // EndDrawing, presenting and polling input
+    PROFILE_STAGES,
+} ProfileStage;
+
+// ProfileEvent is one timed stage. seq is the ring position plus one once the
+// event is complete, 0 while it is being written.
+typedef struct ProfileEvent
+{
+    _Atomic uint64_t seq;
+    int stage;
+    int thread;
+    double start;
+    double end;
+} ProfileEvent;
+
+// Profile keeps the latest timed events of every thread in a lock-free ring.
+// Writers claim a slot with one atomic add and never wait; readers check each
+// slot's sequence around the copy and skip slots that were being rewritten.
+typedef struct Profile
+{
+    ProfileEvent events[PROFILE_CAPACITY];
+    _Atomic uint64_t head;
+    _Atomic bool enabled;
+    double origin; // trace timestamps start here
+} Profile;
+
+// ProfileStats holds the frame time percentiles of one stage over the overlay window
+typedef struct ProfileStats
+{
+    int count;
+    double p50_ms;
+    double p99_ms;
+} ProfileStats;
+
+extern Profile profile;
+
+void profile_enable(bool enabled);
+void profile_record(ProfileStage stage, double start, double end);
+void profile_summarize(ProfileStats stats[PROFILE_STAGES]);
+void profile_draw(const DrawBackend *draw, const ProfileStats stats[PROFILE_STAGES], int x, int y);
+int profile_export(const char *path);
+const char *profile_stage_name(ProfileStage stage);
+
+// Timers are compiled in unless NO_PROFILE is defined; while disabled
+// each costs a relaxed load and a branch.
+#ifndef NO_PROFILE
+static inline double profile_begin(void)
+{
+    return atomic_load_explicit(&profile.enabled, memory_order_relaxed) ? now_seconds() : 0.0;
+}
+
+static inline void profile_end(ProfileStage stage, double start)
+{
+    if (start > 0.0)
+        profile_record(stage, start, now_seconds());
+}
+#else
+static inline double profile_begin(void)
+{
+    return 0.0;
+}
+
+static inline void profile_end(ProfileStage stage, double start)
+{
+    (void)stage;
+    (void)start;
+}
+#endif
@@ -0,0 +1,115 @@
+#include "scene.h"
+#include "profile.h"
+#include "spectrum.h"
+
+#include <stdlib.h>
+
+int scene_init(Scene *scene, const char *title, int width, int height)
+{
+    scene->title = title;
+    scene->width = width;
+    scene->height = height;
+    scene->points = malloc(sizeof(Vector2) * width);
+    scene->columns = malloc(sizeof(PeakColumn) * width);
+    if (!scene->points || !scene->columns)
+    {
+        scene_free(scene);
+        return -1;
+    }
+
+    return 0;
+}
+
+// scene_spectrum draws the levels as bars standing on the waveform area,
+// the loudest bin under each column sets its height
+static void scene_spectrum(Scene *scene, const DrawBackend *draw, const float *db, int bins)
+{
+    const int screenWidth = scene->width;
+    const int bottom = scene->height - 80;
+    const int height = 150;
+    const Color color = { 0, 121, 241, 96 };
+
+    for (int i = 0; i < screenWidth; i++)
+    {
+        int first = (int)((long)i * bins / screenWidth);
+        int last = (int)((long)(i + 1) * bins / screenWidth);
+        float level = db[first];
+        for (int k = first + 1; k < last; k++)
+            if (db[k] > level)
+                level = db[k];
+
+        int bar = (int)((level - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB * height);
+        if (bar > 0)
+            draw->rectangle(draw->user, i, bottom - bar, 1, bar, color);
+    }
+}
+
+void scene_draw(Scene *scene, const DrawBackend *draw, const SceneState *state)
+{
+    const int screenWidth = scene->width;
+    const int screenHeight = scene->height;
+    const Track *track = state->track;
+    PeakColumn *columns = scene->columns;
+    void *user = draw->user;
+
+    double sample_rate = track->sample_rate;
+    float timePlayed = state->time_length > 0 ? state->played_frame / sample_rate / state->time_length * screenWidth : 0.0f;
+
+    draw->clear(user, RAYWHITE);
+
+    draw->text(user, scene->title, (screenWidth - draw->measure_text(user, scene->title, 50)) / 2,
+        (screenHeight - 150) / 2, 50, DARKGRAY);
+
+    if (state->spectrum)
+        scene_spectrum(scene, draw, state->spectrum, state->spectrum_bins);
+
+    draw->rectangle(user, 0, screenHeight - 20, screenWidth, 20, LIGHTGRAY);
+    draw->rectangle(user, 0, screenHeight - 20, (int)timePlayed * 2, 20, MAROON);
+
+    // whole track overview inside the progress bar
+    if (state->time_length > 0)
+    {
+        peaks_query(state->peaks, track, 0.0, state->time_length * sample_rate / screenWidth, screenWidth, columns);
+        for (int i = 0; i < screenWidth; i++)
+        {
+            draw->line(user, (Vector2){ i, (int)(screenHeight - 10 - columns[i].max * 10) },
+                (Vector2){ i, (int)(screenHeight - 9 - columns[i].min * 10) }, DARKGRAY);
+        }
+    }
+
+    int cursor = (int)state->played_frame;
+
+    if (state->frames_per_column <= 1)
+    {
+        double start = profile_begin();
+        for (int i = 0; i < screenWidth; i++)
+        {
+            // samples past the decoded part are drawn as silence
+            float sample = state->waveform ? state->waveform[i] : track_mono(track, cursor + i);
+            scene->points[i] = (Vector2){ i, (screenHeight - 60 - sample) - sample * 15 };
+        }
+        profile_end(PROFILE_WAVEFORM, start);
+
+        draw->line_strip(user, scene->points, screenWidth, BLACK);
+    }
+    else
+    {
+        // zoomed out, draw the min/max envelope of each column instead of aliased samples
+        double start = profile_begin();
+        peaks_query(state->peaks, track, cursor, state->frames_per_column, screenWidth, columns);
+        profile_end(PROFILE_WAVEFORM, start);
+        for (int i = 0; i < screenWidth; i++)
+        {
+            draw->line(user, (Vector2){ i, (int)(screenHeight - 60 - columns[i].max * 16) },
+                (Vector2){ i, (int)(screenHeight - 59 - columns[i].min * 16) }, BLACK);
+        }
+    }
+}
+
+void scene_free(Scene *scene)
+{
+    free(scene->points);
+    free(scene->columns);
+    scene->points = NULL;
+    scene->columns = NULL;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "draw.h"
+#include "peaks.h"
+#include "track.h"
+
+// Scene draws the visualizer frame: title, progress bar with the whole track
+// overview, and the waveform under the play cursor.
+typedef struct Scene
+{
+    const char *title;
+    int width;
+    int height;
+    Vector2 *points; // waveform line strip, one point per column
+    PeakColumn *columns;
+} Scene;
+
+// SceneState is what changes from one frame to the next
+typedef struct SceneState
+{
+    const Track *track;
+    const Peaks *peaks;
+    double played_frame; // frame under the cursor
+    double time_length; // seconds, 0 while unknown
+    int frames_per_column; // waveform zoom, 1 draws the raw samples
+    const float *waveform; // one mono sample per column from the cursor on, NULL reads them from the track
+    const float *spectrum; // levels in dB from DC to Nyquist, NULL draws no spectrum
+    int spectrum_bins;
+} SceneState;
+
+int scene_init(Scene *scene, const char *title, int width, int height);
+void scene_draw(Scene *scene, const DrawBackend *draw, const SceneState *state);
+void scene_free(Scene *scene);
@@ -0,0 +1,165 @@
+#include "segment.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Segment is one time range of the file decoded on its own thread
+// with its own demuxer, decoder and resampler.
+typedef struct Segment
+{
+    const char *path;
+    const DecodeOptions *opts;
+    int64_t start; // first position of the segment, INT64_MIN for the first one
+    int64_t end; // position where the next segment starts, INT64_MAX for the last one
+    int64_t first_pos; // position of the first frame in track
+    Track track; // frames from start up to end + SEGMENT_OVERLAP
+    pthread_t thread;
+    int status;
+} Segment;
+
+static void *segment_thread(void *arg)
+{
+    Segment *seg = (Segment *)arg;
+    DecodeSource src;
+
+    seg->status = -1;
+    if (decode_open(&src, seg->path, seg->opts) != 0)
+        return NULL;
+
+    track_init(&seg->track, src.sample_rate, src.channels, src.sample_format);
+    if (seg->start != INT64_MIN && decode_seek(&src, seg->start - (int64_t)(SEGMENT_PREROLL * src.sample_rate)) != 0)
+    {
+        decode_close(&src);
+        return NULL;
+    }
+
+    src.range_start = seg->start;
+    src.range_end = seg->end == INT64_MAX ? INT64_MAX : seg->end + SEGMENT_OVERLAP;
+    seg->status = decode_run(&src, track_sink, &seg->track);
+    seg->first_pos = src.first_pos;
+
+    // a seek that landed past the segment start leaves a hole
+    if (seg->start != INT64_MIN && seg->first_pos != seg->start)
+        seg->status = -1;
+
+    decode_close(&src);
+
+    return NULL;
+}
+
+// segments_line_up checks that every segment starts exactly where the previous one
+// continues, comparing the overlapping frames bit for bit
+static int segments_line_up(Segment *segs, int count, int frame_size)
+{
+    for (int i = 1; i < count; i++)
+    {
+        Segment *prev = &segs[i - 1];
+        Segment *next = &segs[i];
+
+        // prev decoded SEGMENT_OVERLAP frames past next->start, fewer only if the file ends there
+        int64_t offset = next->start - prev->first_pos;
+        int64_t overlap = next->track.size < SEGMENT_OVERLAP ? next->track.size : SEGMENT_OVERLAP;
+        if (offset < 0 || prev->track.size - offset < overlap)
+            return 0;
+        if (memcmp(track_frame(&prev->track, (int)offset), next->track.data, (size_t)overlap * frame_size) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int decode_file_sequential(const char *path, const DecodeOptions *opts, Track *track)
+{
+    DecodeSource src;
+    if (decode_open(&src, path, opts) != 0)
+        return -1;
+
+    track_init(track, src.sample_rate, src.channels, src.sample_format);
+    track_reserve(track, decode_expected_frames(&src));
+    int ret = decode_run(&src, track_sink, track);
+    decode_close(&src);
+    track->complete = ret == 0;
+
+    return ret;
+}
+
+// decode_file_segmented decodes the whole file into track, splitting it into time segments
+// decoded in parallel. The result is the same as a sequential decode: whenever the segments
+// can't be lined up sample exactly (resampling, imprecise seeking) it falls back to one.
+int decode_file_segmented(const char *path, const DecodeOptions *opts, int segments, Track *track)
+{
+    DecodeSource probe;
+    if (decode_open(&probe, path, opts) != 0)
+        return -1;
+
+    bool native_rate = probe.sample_rate == probe.codec_ctx->sample_rate;
+    int64_t start = decode_start_pos(&probe);
+    int64_t length = (int64_t)decode_expected_frames(&probe);
+    int channels = probe.channels;
+    int rate = probe.sample_rate;
+    decode_close(&probe);
+
+    if (segments <= 1 || !native_rate || length < (int64_t)segments * SEGMENT_PREROLL * rate)
+        return decode_file_sequential(path, opts, track);
+
+    // every segment decodes on a single thread, the segments are the parallelism
+    DecodeOptions segment_opts = *opts;
+    segment_opts.threads = 1;
+
+    Segment *segs = calloc(segments, sizeof(Segment));
+    if (!segs)
+        return -1;
+
+    int started = 0;
+    for (int i = 0; i < segments; i++)
+    {
+        Segment *seg = &segs[i];
+        seg->path = path;
+        seg->opts = &segment_opts;
+        seg->start = i == 0 ? INT64_MIN : start + length * i / segments;
+        seg->end = i == segments - 1 ? INT64_MAX : start + length * (i + 1) / segments;
+        if (pthread_create(&seg->thread, NULL, segment_thread, seg) != 0)
+            break;
+        started++;
+    }
+
+    bool ok = started == segments;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(segs[i].thread, NULL);
+        ok = ok && segs[i].status == 0;
+    }
+    ok = ok && segments_line_up(segs, segments, channels * sample_format_size(opts->format));
+
+    int ret = 0;
+    if (ok)
+    {
+        // stitch the segments, each one cut where the next begins
+        int64_t total = 0;
+        for (int i = 0; i < segments; i++)
+            total += i == segments - 1 ? segs[i].track.size : segs[i + 1].start - segs[i].first_pos;
+
+        track_init(track, rate, channels, opts->format);
+        ret = track_reserve(track, (int)total);
+        for (int i = 0; i < segments && ret == 0; i++)
+        {
+            int frames = i == segments - 1 ? segs[i].track.size : (int)(segs[i + 1].start - segs[i].first_pos);
+            ret = track_append(track, segs[i].track.data, frames);
+            track_free(&segs[i].track);
+        }
+        track->complete = ret == 0;
+    }
+
+    for (int i = 0; i < started; i++)
+        track_free(&segs[i].track);
+    free(segs);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Segments of '%s' don't line up, decoding sequentially\n", path);
+        return decode_file_sequential(path, opts, track);
+    }
+
+    return ret;
+}
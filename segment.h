@@ -0,0 +1,12 @@
+#pragma once
+
+#include "decode.h"
+#include "track.h"
+
+// seconds decoded and thrown away before each segment so the decoder state
+// matches the one of a sequential decode at the segment start
+#define SEGMENT_PREROLL 1.0
+// frames every segment decodes past its end to check that it lines up with the next one
+#define SEGMENT_OVERLAP 4096
+
+int decode_file_segmented(const char *path, const DecodeOptions *opts, int segments, Track *track);
@@ -0,0 +1,199 @@
+#include "spectrogram.h"
+#include "spectrum.h"
+#include "timing.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SpectrogramJob is a contiguous run of columns computed on its own thread
+// with its own FFT tables and scratch
+typedef struct SpectrogramJob
+{
+    Spectrogram *sg;
+    const Track *track;
+    const Bands *bands; // NULL keeps the FFT bins
+    int first;
+    int last;
+    pthread_t thread;
+    int status;
+} SpectrogramJob;
+
+static void *spectrogram_thread(void *arg)
+{
+    SpectrogramJob *job = (SpectrogramJob *)arg;
+    Spectrogram *sg = job->sg;
+    Spectrum spectrum;
+
+    job->status = -1;
+    if (spectrum_init(&spectrum, sg->fft_size) != 0)
+        return NULL;
+
+    float *bands = NULL;
+    if (job->bands && !(bands = malloc(sizeof(float) * sg->rows)))
+    {
+        spectrum_free(&spectrum);
+        return NULL;
+    }
+
+    const float scale = 255.0f / -SPECTRUM_FLOOR_DB;
+    for (int c = job->first; c < job->last; c++)
+    {
+        spectrum_update(&spectrum, job->track, (double)c * sg->hop);
+
+        const float *db = spectrum.db;
+        if (bands)
+        {
+            bands_apply(job->bands, spectrum.magnitude, bands);
+            db = bands;
+        }
+
+        unsigned char *column = sg->levels + (size_t)c * sg->rows;
+        for (int k = 0; k < sg->rows; k++)
+            column[k] = (unsigned char)((db[k] - SPECTRUM_FLOOR_DB) * scale + 0.5f);
+    }
+
+    free(bands);
+    spectrum_free(&spectrum);
+    job->status = 0;
+
+    return NULL;
+}
+
+// spectrogram_build computes every column of the track, the columns split evenly
+// over the given number of threads. With bands only the band levels are kept.
+int spectrogram_build(Spectrogram *sg, const Track *track, int fft_size, int hop, const Bands *bands, int threads)
+{
+    memset(sg, 0, sizeof(*sg));
+    if (hop <= 0 || threads <= 0)
+        return -1;
+
+    double start = now_seconds();
+
+    sg->fft_size = fft_size;
+    sg->hop = hop;
+    sg->rows = bands ? bands->count : fft_size / 2 + 1;
+    sg->columns = track->size / hop + 1;
+    sg->levels = malloc((size_t)sg->columns * sg->rows);
+    if (!sg->levels)
+        return -1;
+
+    if (threads > sg->columns)
+        threads = sg->columns;
+    SpectrogramJob *jobs = calloc(threads, sizeof(SpectrogramJob));
+    if (!jobs)
+    {
+        spectrogram_free(sg);
+        return -1;
+    }
+
+    int started = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        SpectrogramJob *job = &jobs[i];
+        job->sg = sg;
+        job->track = track;
+        job->bands = bands;
+        job->first = (int)((long)sg->columns * i / threads);
+        job->last = (int)((long)sg->columns * (i + 1) / threads);
+        if (pthread_create(&job->thread, NULL, spectrogram_thread, job) != 0)
+            break;
+        started++;
+    }
+
+    int ret = started == threads ? 0 : -1;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(jobs[i].thread, NULL);
+        if (jobs[i].status != 0)
+            ret = -1;
+    }
+    free(jobs);
+
+    if (ret != 0)
+    {
+        spectrogram_free(sg);
+        return -1;
+    }
+
+    sg->build_seconds = now_seconds() - start;
+
+    return 0;
+}
+
+// spectrogram_levels writes the rows levels in dB of the column nearest to frame
+void spectrogram_levels(const Spectrogram *sg, double frame, float *db)
+{
+    int c = (int)(frame / sg->hop + 0.5);
+    if (c < 0)
+        c = 0;
+    if (c >= sg->columns)
+        c = sg->columns - 1;
+
+    const unsigned char *column = sg->levels + (size_t)c * sg->rows;
+    const float scale = -SPECTRUM_FLOOR_DB / 255.0f;
+    for (int k = 0; k < sg->rows; k++)
+        db[k] = SPECTRUM_FLOOR_DB + column[k] * scale;
+}
+
+size_t spectrogram_bytes(const Spectrogram *sg)
+{
+    return (size_t)sg->columns * sg->rows;
+}
+
+void spectrogram_free(Spectrogram *sg)
+{
+    free(sg->levels);
+    sg->levels = NULL;
+    sg->columns = 0;
+}
+
+static void *spectrogram_builder_thread(void *arg)
+{
+    SpectrogramBuilder *builder = (SpectrogramBuilder *)arg;
+
+    builder->status = spectrogram_build(&builder->result, builder->track, builder->fft_size, builder->hop,
+        builder->bands, builder->threads);
+    // publishes the result and status to the thread that sees done
+    atomic_store_explicit(&builder->done, true, memory_order_release);
+
+    return NULL;
+}
+
+// spectrogram_builder_start builds the spectrogram of the track on a background thread.
+// the track and bands must stay untouched until spectrogram_builder_join.
+int spectrogram_builder_start(SpectrogramBuilder *builder, const Track *track, int fft_size, int hop, const Bands *bands, int threads)
+{
+    memset(&builder->result, 0, sizeof(builder->result));
+    builder->track = track;
+    builder->bands = bands;
+    builder->fft_size = fft_size;
+    builder->hop = hop;
+    builder->threads = threads;
+    builder->status = -1;
+    atomic_init(&builder->done, false);
+    builder->running = pthread_create(&builder->thread, NULL, spectrogram_builder_thread, builder) == 0;
+
+    return builder->running ? 0 : -1;
+}
+
+// spectrogram_builder_done tells whether the build finished, without waiting
+bool spectrogram_builder_done(SpectrogramBuilder *builder)
+{
+    return builder->running && atomic_load_explicit(&builder->done, memory_order_acquire);
+}
+
+// spectrogram_builder_join waits for the build and hands the spectrogram to sg, which
+// is left empty when the build failed
+int spectrogram_builder_join(SpectrogramBuilder *builder, Spectrogram *sg)
+{
+    if (!builder->running)
+        return -1;
+
+    pthread_join(builder->thread, NULL);
+    builder->running = false;
+    *sg = builder->result;
+    memset(&builder->result, 0, sizeof(builder->result));
+
+    return builder->status;
+}
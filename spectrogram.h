@@ -0,0 +1,46 @@
+#pragma once
+
+#include "bands.h"
+#include "track.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Spectrogram is the short time spectrum of the whole mono track, computed once
+// after decoding. Column c is centered on frame c * hop and stores every bin, or
+// every band when mapped to bands, as an 8 bit level from SPECTRUM_FLOOR_DB (0) to 0 dB (255).
+typedef struct Spectrogram
+{
+    int fft_size;
+    int hop; // frames between columns
+    int rows; // levels per column, fft_size / 2 + 1 bins or the number of bands
+    int columns;
+    unsigned char *levels; // columns * rows, column after column
+    double build_seconds;
+} Spectrogram;
+
+// SpectrogramBuilder runs spectrogram_build on a background thread. The result is
+// only touched by the builder until spectrogram_builder_done returns true.
+typedef struct SpectrogramBuilder
+{
+    Spectrogram result;
+    const Track *track;
+    const Bands *bands;
+    int fft_size;
+    int hop;
+    int threads;
+    pthread_t thread;
+    bool running;
+    _Atomic bool done;
+    int status;
+} SpectrogramBuilder;
+
+int spectrogram_build(Spectrogram *sg, const Track *track, int fft_size, int hop, const Bands *bands, int threads);
+void spectrogram_levels(const Spectrogram *sg, double frame, float *db);
+size_t spectrogram_bytes(const Spectrogram *sg);
+void spectrogram_free(Spectrogram *sg);
+
+int spectrogram_builder_start(SpectrogramBuilder *builder, const Track *track, int fft_size, int hop, const Bands *bands, int threads);
+bool spectrogram_builder_done(SpectrogramBuilder *builder);
+int spectrogram_builder_join(SpectrogramBuilder *builder, Spectrogram *sg);
@@ -0,0 +1,45 @@
+#include "spectrum.h"
+
+#include <stdlib.h>
+
+int spectrum_init(Spectrum *spectrum, int size)
+{
+    if (fft_init(&spectrum->fft, size) != 0)
+        return -1;
+
+    spectrum->bins = spectrum->fft.bins;
+    spectrum->input = malloc(sizeof(float) * size);
+    spectrum->magnitude = malloc(sizeof(float) * spectrum->bins);
+    spectrum->db = malloc(sizeof(float) * spectrum->bins);
+    if (!spectrum->input || !spectrum->magnitude || !spectrum->db)
+    {
+        spectrum_free(spectrum);
+        return -1;
+    }
+
+    return 0;
+}
+
+void spectrum_update(Spectrum *spectrum, const Track *track, double frame)
+{
+    int size = spectrum->fft.size;
+    int start = (int)frame - size / 2;
+
+    // samples before the start or past the decoded part count as silence
+    for (int i = 0; i < size; i++)
+        spectrum->input[i] = track_mono(track, start + i);
+
+    fft_magnitude(&spectrum->fft, spectrum->input, spectrum->magnitude);
+    fft_decibels(spectrum->magnitude, spectrum->db, spectrum->bins, SPECTRUM_FLOOR_DB);
+}
+
+void spectrum_free(Spectrum *spectrum)
+{
+    fft_free(&spectrum->fft);
+    free(spectrum->input);
+    free(spectrum->magnitude);
+    free(spectrum->db);
+    spectrum->input = NULL;
+    spectrum->magnitude = NULL;
+    spectrum->db = NULL;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "fft.h"
+#include "track.h"
+
+#define SPECTRUM_FLOOR_DB -90.0f
+
+// Spectrum is the frequency analysis of the mono track around the play cursor,
+// updated once per drawn frame.
+typedef struct Spectrum
+{
+    Fft fft;
+    float *input; // mono samples centered on the cursor
+    float *magnitude; // fft.bins amplitudes
+    float *db; // fft.bins levels in dB, clamped to SPECTRUM_FLOOR_DB
+    int bins;
+} Spectrum;
+
+int spectrum_init(Spectrum *spectrum, int size);
+void spectrum_update(Spectrum *spectrum, const Track *track, double frame);
+void spectrum_free(Spectrum *spectrum);
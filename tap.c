@@ -0,0 +1,126 @@
+#include "tap.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+void audio_tap_init(AudioTap *tap)
+{
+    memset(tap->samples, 0, sizeof(tap->samples));
+    for (int i = 0; i < AUDIO_TAP_MARKS; i++)
+    {
+        atomic_init(&tap->marks[i].sequence, 0);
+        atomic_init(&tap->marks[i].position, 0);
+        atomic_init(&tap->marks[i].time, 0.0);
+    }
+    atomic_init(&tap->reserved, 0);
+    atomic_init(&tap->written, 0);
+    tap->pushes = 0;
+    tap->overruns = 0;
+    tap->underruns = 0;
+}
+
+// write_mark rewrites a mark, odd sequence while the fields change
+static void write_mark(AudioTapMark *mark, uint64_t position, double time)
+{
+    uint64_t sequence = atomic_load_explicit(&mark->sequence, memory_order_relaxed);
+    atomic_store_explicit(&mark->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&mark->position, position, memory_order_relaxed);
+    atomic_store_explicit(&mark->time, time, memory_order_relaxed);
+
+    atomic_store_explicit(&mark->sequence, sequence + 2, memory_order_release);
+}
+
+// read_mark copies a mark, false if the producer was rewriting it meanwhile
+static bool read_mark(const AudioTapMark *mark, uint64_t *position, double *time)
+{
+    uint64_t before = atomic_load_explicit(&mark->sequence, memory_order_acquire);
+    *position = atomic_load_explicit(&mark->position, memory_order_relaxed);
+    *time = atomic_load_explicit(&mark->time, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t after = atomic_load_explicit(&mark->sequence, memory_order_relaxed);
+
+    return (before & 1) == 0 && before == after;
+}
+
+// audio_tap_push appends samples, wait free. Only the producer may call it.
+void audio_tap_push(AudioTap *tap, const float *samples, int count)
+{
+    uint64_t w = atomic_load_explicit(&tap->written, memory_order_relaxed);
+
+    // announce the slots about to be overwritten before touching them
+    atomic_store_explicit(&tap->reserved, w + count, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (int i = 0; i < count; i++)
+        tap->samples[(w + i) & (AUDIO_TAP_CAPACITY - 1)] = samples[i];
+    write_mark(&tap->marks[tap->pushes % AUDIO_TAP_MARKS], w, now_seconds());
+    tap->pushes++;
+
+    atomic_store_explicit(&tap->written, w + count, memory_order_release);
+}
+
+uint64_t audio_tap_written(const AudioTap *tap)
+{
+    return atomic_load_explicit(&tap->written, memory_order_acquire);
+}
+
+// audio_tap_read copies count samples starting at position. Samples not pushed yet
+// read as silence and count as an underrun; the return value is the number of samples
+// actually copied. Returns -1, with out silent, when part of the window was already
+// overwritten. pushed_time, if given, gets the hand-off time of the sample at position.
+int audio_tap_read(AudioTap *tap, uint64_t position, float *out, int count, double *pushed_time)
+{
+    uint64_t written = atomic_load_explicit(&tap->written, memory_order_acquire);
+
+    int available = 0;
+    if (position < written)
+        available = written - position < (uint64_t)count ? (int)(written - position) : count;
+
+    if (written > AUDIO_TAP_CAPACITY && position < written - AUDIO_TAP_CAPACITY)
+    {
+        memset(out, 0, sizeof(float) * count);
+        tap->overruns++;
+        return -1;
+    }
+
+    for (int i = 0; i < available; i++)
+        out[i] = tap->samples[(position + i) & (AUDIO_TAP_CAPACITY - 1)];
+    if (available < count)
+    {
+        memset(out + available, 0, sizeof(float) * (count - available));
+        tap->underruns++;
+    }
+
+    double time = 0.0;
+    if (pushed_time && available > 0)
+    {
+        // the newest mark at or before position, a mark being rewritten is newer than
+        // position anyway
+        for (int i = 0; i < AUDIO_TAP_MARKS; i++)
+        {
+            uint64_t mark_position;
+            double mark_time;
+            if (read_mark(&tap->marks[i], &mark_position, &mark_time) && mark_position <= position &&
+                mark_position + AUDIO_TAP_CAPACITY > position && mark_time > time)
+                time = mark_time;
+        }
+    }
+
+    // whatever the producer reserved since then may have replaced the oldest copied samples
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t reserved = atomic_load_explicit(&tap->reserved, memory_order_relaxed);
+    if (available > 0 && reserved > AUDIO_TAP_CAPACITY && position < reserved - AUDIO_TAP_CAPACITY)
+    {
+        memset(out, 0, sizeof(float) * count);
+        tap->overruns++;
+        return -1;
+    }
+
+    if (pushed_time)
+        *pushed_time = time;
+
+    return available;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// mono samples kept by the tap, a power of two (about 1.5 s at 44.1 kHz)
+#define AUDIO_TAP_CAPACITY (1 << 16)
+// hand-off times remembered, one per push
+#define AUDIO_TAP_MARKS 64
+
+// AudioTapMark remembers when a block of samples was handed to the device. The
+// producer rewrites a mark in place, so it is read like a seqlock: sequence is odd
+// while the mark is being written and changes with every write.
+typedef struct AudioTapMark
+{
+    _Atomic uint64_t sequence;
+    _Atomic uint64_t position; // tap position of the first sample of the block
+    _Atomic double time;
+} AudioTapMark;
+
+// AudioTap is a single producer, single consumer ring of the mono samples handed to
+// the audio device. The producer never waits and overwrites the oldest samples; the
+// consumer copies any recent window without locks and finds out afterwards, like a
+// seqlock, whether the producer overwrote part of it meanwhile.
+typedef struct AudioTap
+{
+    float samples[AUDIO_TAP_CAPACITY];
+    AudioTapMark marks[AUDIO_TAP_MARKS];
+    _Atomic uint64_t reserved; // end of the samples the producer may be writing
+    _Atomic uint64_t written; // end of the samples published to the consumer
+    uint64_t pushes; // producer only
+    // consumer only
+    long overruns; // windows lost because the producer got ahead by more than the capacity
+    long underruns; // windows that asked for samples not pushed yet
+} AudioTap;
+
+void audio_tap_init(AudioTap *tap);
+void audio_tap_push(AudioTap *tap, const float *samples, int count);
+uint64_t audio_tap_written(const AudioTap *tap);
+int audio_tap_read(AudioTap *tap, uint64_t position, float *out, int count, double *pushed_time);
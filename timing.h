@@ -0,0 +1,11 @@
+#pragma once
+
+#include <time.h>
+
+// now_seconds returns a monotonic timestamp in seconds
+static inline double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,68 @@
+#include "track.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+void track_init(Track *track, int sample_rate, int channels, SampleFormat format)
+{
+    track->data = NULL;
+    track->size = 0;
+    track->capacity = 0;
+    track->allocations = 0;
+    track->channels = channels;
+    track->sample_rate = sample_rate;
+    track->format = format;
+    track->frame_size = channels * sample_format_size(format);
+    track->complete = false;
+    track->mapping = NULL;
+    track->mapping_size = 0;
+}
+
+// track_reserve makes room for at least the given number of frames
+int track_reserve(Track *track, int frames)
+{
+    if (frames <= track->capacity)
+        return 0;
+
+    void *data = realloc(track->data, (size_t)frames * track->frame_size);
+    if (!data)
+        return -1;
+
+    track->data = data;
+    track->capacity = frames;
+    track->allocations++;
+
+    return 0;
+}
+
+int track_append(Track *track, const void *samples, int frames)
+{
+    if (track->size + frames > track->capacity)
+    {
+        // grow geometrically so long files don't copy the whole track on every append
+        int capacity = track->capacity + track->capacity / 2;
+        if (capacity < track->size + frames)
+            capacity = track->size + frames;
+        if (track_reserve(track, capacity) != 0)
+            return -1;
+    }
+
+    memcpy((char *)track->data + (size_t)track->size * track->frame_size, samples,
+        (size_t)frames * track->frame_size);
+    track->size += frames;
+
+    return 0;
+}
+
+void track_free(Track *track)
+{
+    if (track->mapping)
+        munmap(track->mapping, track->mapping_size);
+    else
+        free(track->data);
+    track->mapping = NULL;
+    track->data = NULL;
+    track->size = 0;
+    track->capacity = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// SampleFormat is the storage format of decoded samples. Float is the default,
+// int16 halves the memory again for long files.
+typedef enum SampleFormat
+{
+    SAMPLE_FORMAT_F32 = 0,
+    SAMPLE_FORMAT_S16
+} SampleFormat;
+
+static inline int sample_format_size(SampleFormat format)
+{
+    return format == SAMPLE_FORMAT_S16 ? 2 : 4;
+}
+
+// Track holds every frame decoded so far. It is the single sample timeline
+// read by both the audio device and the visualization.
+typedef struct Track
+{
+    void *data; // interleaved samples in the track's format
+    int size; // in frames
+    int capacity; // in frames
+    int allocations; // number of times data was (re)allocated
+    int channels;
+    int sample_rate;
+    SampleFormat format;
+    int frame_size; // bytes per interleaved frame
+    bool complete; // the whole file has been decoded
+    void *mapping; // set when data points into a memory mapped cache file
+    size_t mapping_size;
+} Track;
+
+void track_init(Track *track, int sample_rate, int channels, SampleFormat format);
+int track_reserve(Track *track, int frames);
+int track_append(Track *track, const void *samples, int frames);
+void track_free(Track *track);
+
+// track_frame returns a pointer to the first sample of frame i
+static inline const void *track_frame(const Track *track, int i)
+{
+    return (const char *)track->data + (size_t)i * track->frame_size;
+}
+
+// track_mono returns frame i downmixed to mono in the -1..1 range, or silence past the decoded end.
+static inline float track_mono(const Track *track, int i)
+{
+    if (i < 0 || i >= track->size)
+        return 0.0f;
+
+    if (track->format == SAMPLE_FORMAT_S16)
+    {
+        const short *frame = (const short *)track_frame(track, i);
+        int sum = 0;
+        for (int c = 0; c < track->channels; c++)
+            sum += frame[c];
+
+        return sum * (1.0f / 32768.0f) / track->channels;
+    }
+
+    const float *frame = (const float *)track_frame(track, i);
+    float sum = 0.0f;
+    for (int c = 0; c < track->channels; c++)
+        sum += frame[c];
+
+    return sum / track->channels;
+}
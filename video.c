@@ -0,0 +1,426 @@
+#include "video.h"
+#include "canvas.h"
+#include "peaks.h"
+#include "scene.h"
+#include "spectrogram.h"
+#include "timing.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/audio_fifo.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/opt.h"
+#include "libswresample/swresample.h"
+#include "libswscale/swscale.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// frames of the track converted per resampler call
+#define VIDEO_AUDIO_BLOCK 4096
+
+// VideoEncoder muxes the rendered frames and the track's audio into one file
+typedef struct VideoEncoder
+{
+    AVFormatContext *oc;
+    AVCodecContext *venc;
+    AVCodecContext *aenc;
+    AVStream *vst;
+    AVStream *ast;
+    struct SwsContext *sws;
+    struct SwrContext *swr;
+    AVAudioFifo *fifo;
+    AVFrame *vframe;
+    AVFrame *aframe;
+    AVPacket *pkt;
+    uint8_t *convert[AV_NUM_DATA_POINTERS]; // resampler output for one block
+    int convert_frames;
+    int audio_frame_size; // samples per encoded audio frame
+    int64_t audio_pts;
+    int audio_pos; // next track frame to be encoded
+} VideoEncoder;
+
+// sends one frame (or NULL to flush) and writes every packet the encoder hands back
+static int encode_write(VideoEncoder *enc, AVCodecContext *codec, AVStream *stream, AVFrame *frame)
+{
+    int ret = avcodec_send_frame(codec, frame);
+    if (ret < 0)
+        return ret;
+
+    while ((ret = avcodec_receive_packet(codec, enc->pkt)) >= 0)
+    {
+        av_packet_rescale_ts(enc->pkt, codec->time_base, stream->time_base);
+        enc->pkt->stream_index = stream->index;
+        ret = av_interleaved_write_frame(enc->oc, enc->pkt);
+        if (ret < 0)
+            return ret;
+    }
+
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int pick_sample_rate(const AVCodec *codec, int wanted)
+{
+    if (!codec->supported_samplerates)
+        return wanted;
+
+    int best = codec->supported_samplerates[0];
+    for (const int *rate = codec->supported_samplerates; *rate; rate++)
+    {
+        if (*rate == wanted)
+            return wanted;
+        if (abs(*rate - wanted) < abs(best - wanted))
+            best = *rate;
+    }
+
+    return best;
+}
+
+static int video_open_video(VideoEncoder *enc, const VideoOptions *opts)
+{
+    const AVCodec *codec = avcodec_find_encoder(enc->oc->oformat->video_codec);
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (!codec)
+    {
+        fprintf(stderr, "No video encoder available\n");
+        return -1;
+    }
+
+    AVCodecContext *venc = avcodec_alloc_context3(codec);
+    if (!venc)
+        return -1;
+    enc->venc = venc;
+    venc->width = opts->width;
+    venc->height = opts->height;
+    venc->time_base = (AVRational){ 1, opts->fps };
+    venc->framerate = (AVRational){ opts->fps, 1 };
+    venc->gop_size = opts->fps;
+    venc->bit_rate = 4000000;
+    venc->pix_fmt = codec->pix_fmts ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+    if (enc->oc->oformat->flags & AVFMT_GLOBALHEADER)
+        venc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(venc, codec, NULL) < 0)
+    {
+        fprintf(stderr, "Failed to open video encoder '%s'\n", codec->name);
+        return -1;
+    }
+
+    enc->vst = avformat_new_stream(enc->oc, NULL);
+    if (!enc->vst || avcodec_parameters_from_context(enc->vst->codecpar, venc) < 0)
+        return -1;
+    enc->vst->time_base = venc->time_base;
+
+    enc->vframe = av_frame_alloc();
+    if (!enc->vframe)
+        return -1;
+    enc->vframe->format = venc->pix_fmt;
+    enc->vframe->width = venc->width;
+    enc->vframe->height = venc->height;
+    if (av_frame_get_buffer(enc->vframe, 32) < 0)
+        return -1;
+
+    enc->sws = sws_getContext(opts->width, opts->height, AV_PIX_FMT_RGBA,
+        opts->width, opts->height, venc->pix_fmt, SWS_BILINEAR, NULL, NULL, NULL);
+
+    return enc->sws ? 0 : -1;
+}
+
+static int video_open_audio(VideoEncoder *enc, const Track *track)
+{
+    const AVCodec *codec = avcodec_find_encoder(enc->oc->oformat->audio_codec);
+    if (!codec)
+    {
+        fprintf(stderr, "No audio encoder available\n");
+        return -1;
+    }
+
+    AVCodecContext *aenc = avcodec_alloc_context3(codec);
+    if (!aenc)
+        return -1;
+    enc->aenc = aenc;
+    aenc->sample_fmt = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    aenc->sample_rate = pick_sample_rate(codec, track->sample_rate);
+    aenc->channels = track->channels;
+    aenc->channel_layout = av_get_default_channel_layout(track->channels);
+    aenc->bit_rate = 192000;
+    aenc->time_base = (AVRational){ 1, aenc->sample_rate };
+    if (enc->oc->oformat->flags & AVFMT_GLOBALHEADER)
+        aenc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(aenc, codec, NULL) < 0)
+    {
+        fprintf(stderr, "Failed to open audio encoder '%s'\n", codec->name);
+        return -1;
+    }
+
+    enc->ast = avformat_new_stream(enc->oc, NULL);
+    if (!enc->ast || avcodec_parameters_from_context(enc->ast->codecpar, aenc) < 0)
+        return -1;
+    enc->ast->time_base = aenc->time_base;
+
+    enc->audio_frame_size = aenc->frame_size > 0 ? aenc->frame_size : 1024;
+
+    enc->aframe = av_frame_alloc();
+    if (!enc->aframe)
+        return -1;
+    enc->aframe->format = aenc->sample_fmt;
+    enc->aframe->channel_layout = aenc->channel_layout;
+    enc->aframe->sample_rate = aenc->sample_rate;
+    enc->aframe->nb_samples = enc->audio_frame_size;
+    if (av_frame_get_buffer(enc->aframe, 0) < 0)
+        return -1;
+
+    enc->fifo = av_audio_fifo_alloc(aenc->sample_fmt, aenc->channels, enc->audio_frame_size * 2);
+    if (!enc->fifo)
+        return -1;
+
+    // the track's interleaved frames to whatever the encoder wants
+    enc->swr = swr_alloc();
+    av_opt_set_int(enc->swr, "in_channel_layout", aenc->channel_layout, 0);
+    av_opt_set_int(enc->swr, "out_channel_layout", aenc->channel_layout, 0);
+    av_opt_set_int(enc->swr, "in_sample_rate", track->sample_rate, 0);
+    av_opt_set_int(enc->swr, "out_sample_rate", aenc->sample_rate, 0);
+    av_opt_set_sample_fmt(enc->swr, "in_sample_fmt", track->format == SAMPLE_FORMAT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT, 0);
+    av_opt_set_sample_fmt(enc->swr, "out_sample_fmt", aenc->sample_fmt, 0);
+    if (swr_init(enc->swr) < 0)
+        return -1;
+
+    enc->convert_frames = swr_get_out_samples(enc->swr, VIDEO_AUDIO_BLOCK);
+    if (av_samples_alloc(enc->convert, NULL, aenc->channels, enc->convert_frames, aenc->sample_fmt, 0) < 0)
+        return -1;
+
+    return 0;
+}
+
+static void video_close(VideoEncoder *enc)
+{
+    if (enc->convert[0])
+        av_freep(&enc->convert[0]);
+    swr_free(&enc->swr);
+    sws_freeContext(enc->sws);
+    if (enc->fifo)
+        av_audio_fifo_free(enc->fifo);
+    av_frame_free(&enc->vframe);
+    av_frame_free(&enc->aframe);
+    av_packet_free(&enc->pkt);
+    avcodec_free_context(&enc->venc);
+    avcodec_free_context(&enc->aenc);
+    if (enc->oc)
+    {
+        if (!(enc->oc->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&enc->oc->pb);
+        avformat_free_context(enc->oc);
+    }
+}
+
+static int video_open(VideoEncoder *enc, const Track *track, const VideoOptions *opts)
+{
+    memset(enc, 0, sizeof(*enc));
+
+    if (avformat_alloc_output_context2(&enc->oc, NULL, NULL, opts->path) < 0 || !enc->oc)
+    {
+        fprintf(stderr, "Could not pick a container for '%s'\n", opts->path);
+        return -1;
+    }
+
+    enc->pkt = av_packet_alloc();
+    if (!enc->pkt || video_open_video(enc, opts) != 0 || video_open_audio(enc, track) != 0)
+    {
+        video_close(enc);
+        return -1;
+    }
+
+    if (!(enc->oc->oformat->flags & AVFMT_NOFILE) && avio_open(&enc->oc->pb, opts->path, AVIO_FLAG_WRITE) < 0)
+    {
+        fprintf(stderr, "Could not open '%s' for writing\n", opts->path);
+        video_close(enc);
+        return -1;
+    }
+    if (avformat_write_header(enc->oc, NULL) < 0)
+    {
+        fprintf(stderr, "Could not write the header of '%s'\n", opts->path);
+        video_close(enc);
+        return -1;
+    }
+
+    return 0;
+}
+
+// encodes every full audio frame waiting in the fifo, or everything left when flushing
+static int video_drain_audio(VideoEncoder *enc, bool flush)
+{
+    while (av_audio_fifo_size(enc->fifo) >= enc->audio_frame_size || (flush && av_audio_fifo_size(enc->fifo) > 0))
+    {
+        if (av_frame_make_writable(enc->aframe) < 0)
+            return -1;
+
+        int n = av_audio_fifo_read(enc->fifo, (void **)enc->aframe->data, enc->audio_frame_size);
+        if (n < enc->audio_frame_size)
+        {
+            // pad the last frame with silence unless the encoder takes a short one
+            if (enc->aenc->codec->capabilities & AV_CODEC_CAP_SMALL_LAST_FRAME)
+                enc->aframe->nb_samples = n;
+            else
+                av_samples_set_silence(enc->aframe->data, n, enc->audio_frame_size - n,
+                    enc->aenc->channels, enc->aenc->sample_fmt);
+        }
+        enc->aframe->pts = enc->audio_pts;
+        enc->audio_pts += enc->aframe->nb_samples;
+
+        if (encode_write(enc, enc->aenc, enc->ast, enc->aframe) < 0)
+            return -1;
+        enc->aframe->nb_samples = enc->audio_frame_size;
+    }
+
+    return 0;
+}
+
+// encodes the track's audio up to frame end
+static int video_write_audio(VideoEncoder *enc, const Track *track, int end)
+{
+    if (end > track->size)
+        end = track->size;
+
+    while (enc->audio_pos < end)
+    {
+        int n = end - enc->audio_pos;
+        if (n > VIDEO_AUDIO_BLOCK)
+            n = VIDEO_AUDIO_BLOCK;
+
+        const uint8_t *in = (const uint8_t *)track_frame(track, enc->audio_pos);
+        int got = swr_convert(enc->swr, enc->convert, enc->convert_frames, &in, n);
+        if (got < 0 || av_audio_fifo_write(enc->fifo, (void **)enc->convert, got) < got)
+            return -1;
+        enc->audio_pos += n;
+
+        if (video_drain_audio(enc, false) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int video_write_canvas(VideoEncoder *enc, const Canvas *canvas, int64_t pts)
+{
+    if (av_frame_make_writable(enc->vframe) < 0)
+        return -1;
+
+    const uint8_t *src[1] = { (const uint8_t *)canvas->pixels };
+    int stride[1] = { canvas->width * 4 };
+    sws_scale(enc->sws, src, stride, 0, canvas->height, enc->vframe->data, enc->vframe->linesize);
+    enc->vframe->pts = pts;
+
+    return encode_write(enc, enc->venc, enc->vst, enc->vframe);
+}
+
+static int video_finish(VideoEncoder *enc)
+{
+    // whatever the resampler still holds, then the encoders' delayed packets
+    int got = swr_convert(enc->swr, enc->convert, enc->convert_frames, NULL, 0);
+    if (got > 0)
+        av_audio_fifo_write(enc->fifo, (void **)enc->convert, got);
+    if (video_drain_audio(enc, true) != 0)
+        return -1;
+
+    if (encode_write(enc, enc->venc, enc->vst, NULL) < 0 || encode_write(enc, enc->aenc, enc->ast, NULL) < 0)
+        return -1;
+
+    return av_write_trailer(enc->oc) < 0 ? -1 : 0;
+}
+
+// video_render steps the visualization at a fixed frame rate over the whole track as fast
+// as the CPU allows and encodes the frames together with the track's audio.
+int video_render(const Track *track, const VideoOptions *opts)
+{
+    if (track->size <= 0 || opts->fps <= 0)
+        return -1;
+
+    Peaks peaks;
+    peaks_init(&peaks, track->size);
+    peaks_update(&peaks, track, track->size);
+
+    VideoEncoder enc;
+    if (video_open(&enc, track, opts) != 0)
+    {
+        peaks_free(&peaks);
+        return -1;
+    }
+
+    // the same scene as the window, drawn by the CPU rasterizer, with the
+    // spectrum looked up from a spectrogram computed on every core up front
+    Canvas canvas = { 0 };
+    Scene scene = { 0 };
+    DrawBackend draw;
+    Spectrogram spectrogram = { 0 };
+    Bands bands = { 0 };
+    float *levels = NULL;
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int ret = -1;
+    if (canvas_init(&canvas, opts->width, opts->height) == 0
+        && scene_init(&scene, opts->title, opts->width, opts->height) == 0
+        && (opts->bands.count <= 0 || bands_init(&bands, &opts->bands, opts->fft_size, track->sample_rate) == 0)
+        && spectrogram_build(&spectrogram, track, opts->fft_size, opts->hop, bands.count > 0 ? &bands : NULL, cores) == 0
+        && (levels = malloc(sizeof(float) * spectrogram.rows)))
+        ret = 0;
+    canvas_backend(&canvas, &draw);
+
+    double seconds = (double)track->size / track->sample_rate;
+    if (ret == 0)
+    {
+        TraceLog(LOG_INFO, "MUSICVIZ: Spectrogram of %d columns built in %.2f s (%.3f s per minute of audio), %.1f MB",
+            spectrogram.columns, spectrogram.build_seconds, spectrogram.build_seconds * 60.0 / seconds,
+            spectrogram_bytes(&spectrogram) / (1024.0 * 1024.0));
+    }
+
+    int64_t frames = (int64_t)ceil(seconds * opts->fps);
+    double start = now_seconds();
+
+    for (int64_t n = 0; n < frames && ret == 0; n++)
+    {
+        double frame = (double)n * track->sample_rate / opts->fps;
+        spectrogram_levels(&spectrogram, frame, levels);
+
+        SceneState state = {
+            .track = track,
+            .peaks = &peaks,
+            .played_frame = frame,
+            .time_length = seconds,
+            .frames_per_column = 1,
+            .spectrum = levels,
+            .spectrum_bins = spectrogram.rows,
+        };
+        scene_draw(&scene, &draw, &state);
+
+        ret = video_write_canvas(&enc, &canvas, n);
+        if (ret == 0)
+            ret = video_write_audio(&enc, track, (int)((double)(n + 1) * track->sample_rate / opts->fps));
+    }
+    if (ret == 0)
+        ret = video_finish(&enc);
+
+    double elapsed = now_seconds() - start;
+    if (ret == 0)
+    {
+        TraceLog(LOG_INFO, "MUSICVIZ: Rendered %lld frames of %s in %.2f s: %.1f fps, %.2fx real time",
+            (long long)frames, opts->path, elapsed, frames / elapsed, seconds / elapsed);
+    }
+    else
+    {
+        fprintf(stderr, "Rendering '%s' failed\n", opts->path);
+    }
+
+    free(levels);
+    spectrogram_free(&spectrogram);
+    bands_free(&bands);
+    scene_free(&scene);
+    canvas_free(&canvas);
+    video_close(&enc);
+    peaks_free(&peaks);
+
+    return ret;
+}
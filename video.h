@@ -0,0 +1,19 @@
+#pragma once
+
+#include "bands.h"
+#include "track.h"
+
+// VideoOptions describes a headless render of the visualization to a video file
+typedef struct VideoOptions
+{
+    const char *path; // output file, the container is picked from the extension
+    const char *title;
+    int width;
+    int height;
+    int fps;
+    int fft_size; // spectrum analysis size
+    int hop; // frames between spectrogram columns
+    BandOptions bands; // count 0 draws the linear FFT bins
+} VideoOptions;
+
+int video_render(const Track *track, const VideoOptions *opts);